@@ -0,0 +1,66 @@
+// converts binary observer output (.bin, .dcol) to csv
+//
+// dances_bin2csv <file.bin|file.dcol> [columns=N] [precision=N] [out=file.csv] [threads=N]
+//
+// .bin: self-describing files carry their column layout. For headerless
+// files (older runs) the column count is taken from the header line of
+// an existing csv file, as written by the observers, or from columns=N.
+// .dcol: self-describing, decoded chunk by chunk.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <algorithm>
+#include <filesystem>
+#include <tbb/global_control.h>
+#include <libs/cmd_line.h>
+#include <model/analysis/bin2csv.hpp>
+#include <model/analysis/dcol.hpp>
+
+
+int main(int argc, const char* argv[])
+{
+  try {
+    if (argc < 2) {
+      std::cerr << "usage: dances_bin2csv <file.bin|file.dcol> [columns=N] [precision=N] [out=file.csv] [threads=N]" << std::endl;
+      return -1;
+    }
+    const auto bin_path = std::filesystem::path(argv[1]);
+    auto clp = cmd::cmd_line_parser(argc - 1, argv + 1);
+    auto csv_path = std::filesystem::path(bin_path).replace_extension(".csv");
+    clp.optional("out", csv_path);
+    analysis::bin2csv_options opt;
+    clp.optional("precision", opt.precision);
+    int threads = -1;
+    clp.optional("threads", threads);
+    tbb::global_control gc(tbb::global_control::max_allowed_parallelism, threads > 0 ? threads : tbb::this_task_arena::max_concurrency());
+
+    if (bin_path.extension() == ".dcol") {
+      const auto dc = analysis::dcol::reader(bin_path);
+      auto os = std::ofstream(csv_path, std::ios::binary | std::ios::trunc);
+      os << dc.header() << '\n';
+      std::vector<float> rows;
+      for (size_t i = 0; i < dc.chunks().size(); ++i) {
+        dc.read_chunk(i, rows);
+        analysis::format_csv(os, rows.data(), rows.size() / dc.columns(), dc.columns(), opt);
+      }
+      if (!os) throw std::runtime_error("can't write " + csv_path.string());
+      std::cout << dc.rows() << " rows written to " << csv_path.string() << std::endl;
+      return 0;
+    }
+
+    size_t columns = 0;
+    clp.optional("columns", columns);
+    const auto bin = analysis::bin::reader(bin_path, columns);
+    auto os = std::ofstream(csv_path, std::ios::binary | std::ios::trunc);
+    if (!bin.header().empty()) os << bin.header() << '\n';
+    analysis::format_csv(os, bin.data(), bin.rows(), bin.columns(), opt);
+    if (!os) throw std::runtime_error("can't write " + csv_path.string());
+    std::cout << bin.rows() << " rows written to " << csv_path.string() << std::endl;
+    return 0;
+  }
+  catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+  }
+  return -1;
+}
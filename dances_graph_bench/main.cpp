@@ -0,0 +1,118 @@
+// thread scaling of the concurrent connected components in libs/graph.hpp
+//
+// dances_graph_bench [n=N] [degree=D] [reps=R] [threads=T] [seed=S]
+//
+// Random graph with n vertices and n * degree / 2 edges. Times
+// connected_components_from_edges and connected_components_from_candidates
+// for 1, 2, 4, .. T threads against a serial BFS over the adjacency lists.
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <algorithm>
+#include <tbb/global_control.h>
+#include <libs/cmd_line.h>
+#include <libs/graph.hpp>
+
+
+namespace {
+
+  // best of 'reps' runs [ms]
+  template <typename Fun>
+  double time_ms(size_t reps, Fun&& fun)
+  {
+    double best = std::numeric_limits<double>::max();
+    for (size_t r = 0; r < reps; ++r) {
+      const auto t0 = std::chrono::steady_clock::now();
+      fun();
+      best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+    }
+    return best;
+  }
+
+
+  // serial baseline, returns the number of components
+  size_t bfs_components(const std::vector<std::vector<unsigned>>& adj)
+  {
+    std::vector<bool> visited(adj.size(), false);
+    std::vector<unsigned> queue;
+    size_t cc = 0;
+    for (unsigned i = 0; i < adj.size(); ++i) {
+      if (visited[i]) continue;
+      ++cc;
+      visited[i] = true;
+      queue.assign(1, i);
+      for (size_t q = 0; q < queue.size(); ++q) {
+        for (auto j : adj[queue[q]]) {
+          if (!visited[j]) {
+            visited[j] = true;
+            queue.push_back(j);
+          }
+        }
+      }
+    }
+    return cc;
+  }
+
+}
+
+
+int main(int argc, const char* argv[])
+{
+  try {
+    auto clp = cmd::cmd_line_parser(argc, argv);
+    size_t n = 1000000;
+    double degree = 2.0;
+    size_t reps = 5;
+    size_t max_threads = tbb::this_task_arena::max_concurrency();
+    uint64_t seed = 42;
+    clp.optional("n", n);
+    clp.optional("degree", degree);
+    clp.optional("reps", reps);
+    clp.optional("threads", max_threads);
+    clp.optional("seed", seed);
+    max_threads = std::max(size_t(1), max_threads);
+
+    auto rng = std::mt19937_64(seed);
+    auto vdist = std::uniform_int_distribution<unsigned>(0, static_cast<unsigned>(n - 1));
+    std::vector<std::pair<unsigned, unsigned>> edges(static_cast<size_t>(n * degree / 2));
+    std::vector<std::vector<unsigned>> adj(n);
+    for (auto& e : edges) {
+      e = { vdist(rng), vdist(rng) };
+      adj[e.first].push_back(e.second);
+      adj[e.second].push_back(e.first);
+    }
+
+    size_t cc = 0;
+    const double bfs_ms = time_ms(reps, [&]() { cc = bfs_components(adj); });
+    std::cout << "n " << n << ", " << edges.size() << " edges, " << cc << " components\n"
+              << std::fixed << std::setprecision(2)
+              << "serial bfs: " << bfs_ms << " ms\n"
+              << "threads    edges [ms]  speedup    candidates [ms]  speedup\n";
+    for (size_t threads = 1;; threads = std::min(2 * threads, max_threads)) {
+      tbb::global_control gc(tbb::global_control::max_allowed_parallelism, threads);
+      size_t cce = 0, ccc = 0;
+      const double edges_ms = time_ms(reps, [&]() { cce = graph::connected_components_from_edges(n, edges).size(); });
+      const double cand_ms = time_ms(reps, [&]() {
+        ccc = graph::connected_components_from_candidates(n,
+          [&](unsigned i, auto&& visit) { for (auto j : adj[i]) visit(j); },
+          [](unsigned, unsigned) { return true; }).size();
+      });
+      if (cce != cc || ccc != cc) throw std::runtime_error("component count mismatch");
+      std::cout << std::setw(7) << threads
+                << std::setw(16) << edges_ms << std::setw(9) << bfs_ms / edges_ms
+                << std::setw(19) << cand_ms << std::setw(9) << bfs_ms / cand_ms << '\n';
+      if (threads == max_threads) break;
+    }
+    return 0;
+  }
+  catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+  }
+  return -1;
+}
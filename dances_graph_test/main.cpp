@@ -0,0 +1,110 @@
+// graph::connected_components_from_edges, connected_components_from_candidates
+// and parallel_connected_components against the serial BFS
+// graph::connected_components on random graphs.
+//
+// dances_graph_test [graphs=N] [seed=S]
+//
+// Returns 0 if all components agree.
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <tbb/global_control.h>
+#include <libs/cmd_line.h>
+#include <libs/graph.hpp>
+
+
+namespace {
+
+  struct random_graph
+  {
+    size_t n = 0;
+    std::vector<std::pair<unsigned, unsigned>> edges;
+    std::vector<std::vector<unsigned>> adj;
+    std::vector<bool> adjm;                     // adjacency matrix, n x n
+
+    bool connected(unsigned i, unsigned j) const { return adjm[i * n + j]; }
+  };
+
+
+  // 'm' uniform random edges over [0, n), self loops and duplicates included
+  random_graph make_random_graph(size_t n, size_t m, std::mt19937_64& rng)
+  {
+    random_graph g;
+    g.n = n;
+    g.adj.resize(n);
+    g.adjm.assign(n * n, false);
+    auto vdist = std::uniform_int_distribution<unsigned>(0, static_cast<unsigned>(n - 1));
+    for (size_t e = 0; e < m; ++e) {
+      const auto a = vdist(rng);
+      const auto b = vdist(rng);
+      g.edges.emplace_back(a, b);
+      g.adj[a].push_back(b);
+      g.adj[b].push_back(a);
+      g.adjm[a * n + b] = g.adjm[b * n + a] = true;
+    }
+    return g;
+  }
+
+
+  // serial reference, members in ascending order
+  graph::components_t<unsigned> reference(const random_graph& g)
+  {
+    auto cc = graph::connected_components(0u, static_cast<unsigned>(g.n), [&](unsigned i, unsigned j) { return g.connected(i, j); });
+    for (auto& c : cc) std::sort(c.begin(), c.end());
+    return cc;
+  }
+
+
+  bool check(const char* name, const random_graph& g, const graph::components_t<unsigned>& ref, const graph::components_t<unsigned>& cc)
+  {
+    if (cc == ref) return true;
+    std::cerr << name << " failed: n=" << g.n << " edges=" << g.edges.size()
+              << " components " << cc.size() << " expected " << ref.size() << std::endl;
+    return false;
+  }
+
+}
+
+
+int main(int argc, const char* argv[])
+{
+  try {
+    auto clp = cmd::cmd_line_parser(argc, argv);
+    size_t graphs = 200;
+    uint64_t seed = 42;
+    clp.optional("graphs", graphs);
+    clp.optional("seed", seed);
+    auto rng = std::mt19937_64(seed);
+    size_t failed = 0;
+    for (size_t k = 0; k < graphs; ++k) {
+      // around the percolation threshold m = n/2 and on both sides of it
+      const size_t n = std::uniform_int_distribution<size_t>(1, 2000)(rng);
+      const size_t m = static_cast<size_t>(std::uniform_real_distribution<double>(0.0, 1.5)(rng) * n);
+      const auto g = make_random_graph(n, m, rng);
+      const auto ref = reference(g);
+      for (size_t threads : { size_t(1), size_t(tbb::this_task_arena::max_concurrency()) }) {
+        tbb::global_control gc(tbb::global_control::max_allowed_parallelism, threads);
+        failed += !check("connected_components_from_edges", g, ref, graph::connected_components_from_edges(g.n, g.edges));
+        // candidates include non-edges, rejected by pred
+        failed += !check("connected_components_from_candidates", g, ref, graph::connected_components_from_candidates(g.n,
+          [&](unsigned i, auto&& visit) {
+            for (auto j : g.adj[i]) visit(j);
+            visit((i + 1) % static_cast<unsigned>(g.n));
+          },
+          [&](unsigned i, unsigned j) { return g.connected(i, j); }));
+        failed += !check("parallel_connected_components", g, ref, graph::parallel_connected_components(0u, static_cast<unsigned>(g.n),
+          [&](unsigned i, unsigned j) { return g.connected(i, j); }));
+      }
+    }
+    std::cout << graphs << " random graphs, " << failed << " failures" << std::endl;
+    return failed ? -1 : 0;
+  }
+  catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+  }
+  return -1;
+}
@@ -56,6 +56,7 @@ void AppWin::run_simulation(model::Simulation* sim,
   auto next_gui_time = watch.elapsed<microseconds>();
   auto next_fps_time = watch.elapsed<microseconds>();
   auto Tmax = sim->time2tick(double(J["Simulation"]["Tmax"]));
+  if (sim->snapshot_interval() == 0) sim->snapshot_interval(1);
   sim->initialize(observer, ss);
   renderer_->flush(*this, *sim, true);
 
@@ -98,6 +99,7 @@ void AppWin::run_simulation(model::Simulation* sim,
     }
     if (now >= next_gui_time) {
       if (!worked) {
+        if (paused_) sim->publish_snapshot();   // reflect changes made in the gui
         renderer_->flush(*this, *sim, false);
       }
       ++gui_ticks;
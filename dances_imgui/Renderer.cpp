@@ -444,16 +444,12 @@ namespace gl {
 
 
   template <size_t I>
-  void flush_species(Renderer* self, const model::Simulation& sim, Renderer::species_array& gls) {
-    using Tag = std::integral_constant<size_t, I>;
-    auto pInst = gls[I].pInstance;
-    gls[I].size = static_cast<GLsizeiptr>(sim.visit_all<std::integral_constant<size_t, I>>([psim = &sim, p = pInst](const auto& ind, size_t idx) mutable {
-      *p = ind.instance_proxy(idx, psim);
-      p->alpha = 1.f;
-      ++p;
-    }));
+  void flush_species(Renderer* self, const model::state_snapshot& snap, Renderer::species_array& gls) {
+    const auto& sp = std::get<I>(snap.species);
+    std::copy(sp.instances.cbegin(), sp.instances.cend(), gls[I].pInstance);
+    gls[I].size = static_cast<GLsizeiptr>(sp.size());
     if constexpr ((I + 1) < model::n_species) {
-      flush_species<I + 1>(self, sim, gls);
+      flush_species<I + 1>(self, snap, gls);
     }
   }
 
@@ -461,8 +457,9 @@ namespace gl {
   void Renderer::flush(const AppWin& app, const model::Simulation& sim, bool trails) {
     WaitForSync(flush_sync_);
     DeleteSync(flush_sync_);
-    tick_ = sim.tick();
-    flush_species<0>(this, sim, species_);
+    const auto& snap = sim.acquire_snapshot();    // never touches live agents
+    tick_ = snap.tick;
+    flush_species<0>(this, snap, species_);
     if (trails) {
       for (auto& sp : species_) sp.trail.push_back(sp.vbo_inst);
     }
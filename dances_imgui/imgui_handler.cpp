@@ -312,9 +312,10 @@ namespace handler {
 		
 		void update_observables_(const model::Simulation* sim)
 		{
-			// A calculation for each observable 
-			const auto& group = sim->pop<Tag>();
-			const auto pop_size = group.size();
+			// A calculation for each observable, from the latest snapshot
+			const auto& snap = sim->acquire_snapshot();
+			const auto& sp = std::get<Tag::value>(snap.species);
+			const auto pop_size = sp.size();
 
 			//to_show_.ind_speed.resize(pop_size, 0.f);
 			//to_show_.ind_stress.resize(pop_size, 0.f);
@@ -325,35 +326,26 @@ namespace handler {
 			to_show_.ind_stress.clear();
 			to_show_.nnd.clear();
 			to_show_.ind_y.clear();
+			if (pop_size == 0) return;
 
 			float sum_speed = 0.f;
-			sim->visit_all<Tag>([&](auto& p, size_t idx) {
-				sum_speed += p.speed;
-	/*			to_show_.ind_speed[idx] = p.speed;
-				to_show_.ind_y[idx] = p.pos.y;
-				to_show_.ind_stress[idx] = p.speed;*/
-
-				to_show_.ind_speed.push_back(p.speed);
-				to_show_.ind_y.push_back(p.pos.y);
-				to_show_.ind_stress.push_back(p.stress);
-
-				const auto& all_nb = sim->sorted_view<Tag>(idx); // all neighbors
-				if (all_nb.size())	{
-						to_show_.nnd.push_back(std::sqrt(all_nb.cbegin()->dist2));
+			auto mean_ofs_center = glm::vec2(0.f);
+			for (size_t i = 0; i < sp.size(); ++i) {
+				sum_speed += sp.instances[i].speed;
+				to_show_.ind_speed.push_back(sp.instances[i].speed);
+				to_show_.ind_y.push_back(sp.pos[i].y);
+				to_show_.ind_stress.push_back(sp.stress[i]);
+				if (sp.nnd[i] > 0.f) {
+					to_show_.nnd.push_back(sp.nnd[i]);
 				}
-			});
+				mean_ofs_center += math::ofs(glm::vec2(sp.pos[i].x, sp.pos[i].z), roost_pos_plane_);
+			}
 
 			to_show_.mean_speed.push_back(sum_speed / pop_size);
 
-			auto mean_ofs_center = glm::vec2(0.f);
-
-			sim->visit_all<Tag>([&](auto& p, size_t idx) {
-				mean_ofs_center += math::ofs(glm::vec2(p.pos.x, p.pos.z), roost_pos_plane_);
-			});
-
 			to_show_.dist_from_roost_square.push_back(glm::length2(mean_ofs_center) / pop_size);
 
-			to_show_.time.push_back(sim->tick2time(sim->tick()));
+			to_show_.time.push_back(sim->tick2time(snap.tick));
 		}
 
 		personalized_imgui::ColorThemeEditor ImguiThemeEditor_;
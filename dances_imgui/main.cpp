@@ -2,17 +2,44 @@
 #include <iostream>
 #include <future>
 #include <thread>
+#include <random>
 #include <tbb/tbb.h>
 #include <tbb/global_control.h>
 #include <model/json.hpp>
 #include <model/model.hpp>
+#include <model/checkpoint.hpp>
 #include <libs/cmd_line.h>
 #include "AppWin.h"
 #include "analysis/meta_obs.hpp"
+#include "analysis/replay.hpp"
 
 
 namespace headless {
 
+  // "folder" of the checkpoint section, default: 'checkpoints' below the observer output
+  std::filesystem::path checkpoint_folder(const json& J)
+  {
+    auto folder = std::filesystem::path(optional_json<std::string>(J["Simulation"]["checkpoint"], "folder").value_or(""));
+    if (folder.empty()) {
+      const auto& ja = J["Simulation"]["Analysis"];
+      folder = (ja.contains("output_path") ? std::filesystem::path(std::string(ja["output_path"])) : exe_path::get()) / "checkpoints";
+    }
+    return folder;
+  }
+
+
+  // optional periodic checkpoints
+  // "checkpoint": { "interval": [s], "folder": "", "keep": 2 }
+  std::unique_ptr<model::checkpoint::async_writer> create_checkpoint_writer(const json& J, model::tick_t& interval)
+  {
+    const auto jc = optional_json<json>(J["Simulation"], "checkpoint");
+    if (!jc) return nullptr;
+    interval = model::Simulation::time2tick(double((*jc)["interval"]));
+    if (interval <= 0) return nullptr;
+    return std::make_unique<model::checkpoint::async_writer>(checkpoint_folder(J), optional_json<size_t>(*jc, "keep").value_or(2));
+  }
+
+
   // model thread function
   void run_simulation(model::Simulation* sim,
                       const species_instances& ss,
@@ -20,16 +47,163 @@ namespace headless {
                       const json& J)
   {
     auto Tmax = sim->time2tick(double(J["Simulation"]["Tmax"]));
+    model::tick_t ckpt_interval = 0;
+    auto ckpt_writer = create_checkpoint_writer(J, ckpt_interval);
     sim->initialize(observer, ss);
     while (!sim->terminated()) {
       sim->update(observer);
-      if (sim->tick() == Tmax) {
+      if (ckpt_writer && (sim->tick() % ckpt_interval) == 0) {
+        // image is taken synchronously, written in the background
+        ckpt_writer->write("checkpoint_" + std::to_string(sim->tick()) + ".bin", model::checkpoint::snapshot(*sim));
+      }
+      if (sim->tick() >= Tmax) {
         break;
       }
     }
+    if (ckpt_writer) ckpt_writer->wait();
     observer->notify(model::Simulation::Finished, *sim);
   }
 
+
+  // warms up once, then runs replicates (branches) forked from the same moment concurrently.
+  // Each branch gets its own random streams, predator initial condition and observer folder.
+  // "fork": { "warmup": [s], "branches": N, "seed": optional }
+  void run_branches(model::Simulation* sim,
+                    const species_instances& ss,
+                    model::Observer* observer,
+                    const json& J)
+  {
+    const auto& jf = J["Simulation"]["fork"];
+    const auto Tmax = sim->time2tick(double(J["Simulation"]["Tmax"]));
+    const auto Twarmup = sim->time2tick(double(jf["warmup"]));
+    const size_t branches = jf["branches"];
+    const uint64_t seed = optional_json<uint64_t>(jf, "seed").value_or(std::random_device{}());
+    sim->initialize(observer, ss);
+    while (!sim->terminated() && sim->tick() < Twarmup) {
+      sim->update(observer);
+    }
+    observer->notify(model::Simulation::Finished, *sim);
+    const auto& ja = J["Simulation"]["Analysis"];
+    const auto output_path = ja.contains("output_path") ? std::filesystem::path(std::string(ja["output_path"])) : exe_path::get();
+    tbb::parallel_for(size_t(0), branches, [&](size_t b) {
+      auto branch = sim->fork();
+      branch->reseed(seed + b);
+      model::reng = rndutils::make_random_engine<>(~(seed + b));
+      species_instances bss;
+      std::get<model::pred_tag::value>(bss) = model::Pred::init_pop(*branch, J["Pred"]);
+      auto observers = analysis::CreateObserverChain<model::prey_tag>(J, output_path / ("branch_" + std::to_string(b)));
+      auto bobs = model::ObserverScheduler{};
+      for (auto& obs : observers) bobs.append_observer(obs.get());
+      branch->initialize(&bobs, bss);
+      while (!branch->terminated() && branch->tick() < Tmax) {
+        branch->update(&bobs);
+      }
+      bobs.notify(model::Simulation::Finished, *branch);
+    });
+  }
+
+
+  // runs independent replicates concurrently in the shared task arena.
+  // Small replicates run serially within one task, large ones use intra-replicate parallelism.
+  // All members share Simulation::dt().
+  // "ensemble": { "replicates": N, "seeds": [...], "configs": [...], "serial_below": 512 }
+  void run_ensemble(json& J)
+  {
+    const auto& je = J["Simulation"]["ensemble"];
+    std::vector<json> members;
+    if (je.contains("configs")) {
+      for (const std::string c : je["configs"]) {
+        members.push_back(compose_json("", std::filesystem::absolute(c)));
+      }
+    }
+    else {
+      members.push_back(J);
+    }
+    const size_t replicates = optional_json<size_t>(je, "replicates").value_or(1);
+    const size_t serial_below = optional_json<size_t>(je, "serial_below").value_or(512);
+    const size_t R = members.size() * replicates;
+    auto seeds = optional_json<std::vector<uint64_t>>(je, "seeds").value_or(std::vector<uint64_t>{});
+    if (seeds.empty()) {
+      const uint64_t base = std::random_device{}();
+      for (size_t r = 0; r < R; ++r) seeds.push_back(base + r);
+    }
+    if (seeds.size() < R) throw std::runtime_error("ensemble: not enough seeds");
+    for (const auto& m : members) {
+      if (float(m["Simulation"]["dt"]) != float(J["Simulation"]["dt"])) {
+        throw std::runtime_error("ensemble: members must share dt");
+      }
+    }
+    std::filesystem::path base;
+    auto& ja = J["Simulation"]["Analysis"];
+    if (ja.is_object() && !ja.value("data_folder", std::string{}).empty()) {
+      base = analysis::unique_output_folder(ja);
+      save_json(J, base / std::string(J["Simulation"]["name"]));
+    }
+    tbb::parallel_for(size_t(0), R, [&](size_t r) {
+      auto Jr = members[r / replicates];
+      Jr["Simulation"]["seed"] = seeds[r];
+      auto sim = std::make_unique<model::Simulation>(Jr);    // before observers, sets dt
+      sim->serial(size_t(Jr["Prey"]["N"]) + size_t(Jr["Pred"]["N"]) < serial_below);
+      std::vector<std::unique_ptr<Observer>> observers;
+      if (!base.empty()) {
+        const auto folder = base / ("replicate_" + std::to_string(r));
+        std::filesystem::create_directories(folder);
+        Jr["Simulation"]["Analysis"]["output_path"] = folder.string();
+        save_json(Jr, folder / std::string(Jr["Simulation"]["name"]));
+        observers = analysis::CreateObserverChain<model::prey_tag>(Jr, folder);
+      }
+      auto& js = Jr["Simulation"];
+      if (js.contains("checkpoint") && (base.empty() || js["checkpoint"].contains("folder"))) {
+        // replicates don't share a checkpoint folder
+        js["checkpoint"]["folder"] = (checkpoint_folder(Jr) / ("replicate_" + std::to_string(r))).string();
+      }
+      auto robs = model::ObserverScheduler{};
+      for (auto& obs : observers) robs.append_observer(obs.get());
+      run_simulation(sim.get(), species_instances{}, &robs, Jr);
+    });
+  }
+
+
+  // re-analyses the recorded runs at or below 'root' concurrently with the
+  // observers configured in J, see analysis/replay.hpp. Each run is rebuilt
+  // from its own composed config; all runs must share dt.
+  // "replay": { "output": "replay", "neighbor_info": true, "serial_below": 512 }
+  void run_replay(const json& J, const std::filesystem::path& root)
+  {
+    const auto jr = optional_json<json>(J["Simulation"], "replay").value_or(json::object());
+    const auto output = optional_json<std::string>(jr, "output").value_or("replay");
+    const bool neighbor_info = optional_json<bool>(jr, "neighbor_info").value_or(true);
+    const size_t serial_below = optional_json<size_t>(jr, "serial_below").value_or(512);
+    const std::string name = J["Simulation"]["name"];
+    const auto runs = analysis::replay::find_runs(root);
+    if (runs.empty()) throw std::runtime_error("replay: no recordings found in " + root.string());
+    std::vector<json> members;
+    for (const auto& folder : runs) {
+      auto Jr = std::filesystem::exists(folder / name) ? compose_json("", folder / name) : J;
+      Jr["Simulation"]["Analysis"]["Observers"] = J["Simulation"]["Analysis"]["Observers"];
+      if (!members.empty() && float(Jr["Simulation"]["dt"]) != float(members.front()["Simulation"]["dt"])) {
+        throw std::runtime_error("replay: runs must share dt");
+      }
+      members.push_back(std::move(Jr));
+    }
+    tbb::parallel_for(size_t(0), runs.size(), [&](size_t r) {
+      auto& Jr = members[r];
+      const auto folder = runs[r] / output;
+      try {
+        std::filesystem::create_directories(folder);
+        Jr["Simulation"]["Analysis"]["output_path"] = folder.string();
+        save_json(Jr, folder / name);
+        const bool serial = size_t(Jr["Prey"]["N"]) + size_t(Jr["Pred"]["N"]) < serial_below;
+        const auto rs = analysis::replay::run<model::prey_tag>(Jr, runs[r], folder, neighbor_info, serial);
+        std::cout << "replay " << runs[r].string() << ": " << rs.loaded << " of " << rs.frames << " frames, "
+                  << rs.samples << " samples, " << rs.ms / 1000 << " s" << std::endl;
+      }
+      catch (const std::exception& err) {
+        std::cerr << "replay " << runs[r].string() << ": " << err.what() << std::endl;
+      }
+    });
+  }
+
 }
 
 
@@ -40,21 +214,37 @@ const static species_instances initial_snapshot = {
 };
 
 
-void run(json& J)
+void run(json& J, const std::filesystem::path& restore, const std::filesystem::path& replay)
 {
   unsigned numThreads = J["Simulation"]["numThreads"];
   if (numThreads == -1) numThreads = std::thread::hardware_concurrency();
   numThreads = std::clamp(numThreads, 1u, std::thread::hardware_concurrency());
   tbb::global_control tbbgc(tbb::global_control::max_allowed_parallelism, numThreads);
+  if (!replay.empty()) {
+    headless::run_replay(J, replay);
+    return;
+  }
+  if (imgui_guard::gImgg()->headless() && J["Simulation"].contains("ensemble")) {
+    headless::run_ensemble(J);
+    return;
+  }
   model::species_instances ss = initial_snapshot;
   auto sim = std::make_unique<model::Simulation>(J);
+  if (!restore.empty()) {
+    model::checkpoint::restore(*sim, model::checkpoint::read(restore));
+  }
   auto observers = analysis::CreateObserverChain<model::prey_tag>(J);
-  auto observer = std::make_unique<Observer>();
+  auto observer = std::make_unique<model::ObserverScheduler>();
   std::for_each(observers.begin(), observers.end(), [&](const std::unique_ptr<Observer>& obs) {
     observer->append_observer(obs.get());
   });
   if (imgui_guard::gImgg()->headless()) {
-    headless::run_simulation(sim.get(), ss, observer.get(), J);
+    if (J["Simulation"].contains("fork")) {
+      headless::run_branches(sim.get(), ss, observer.get(), J);
+    }
+    else {
+      headless::run_simulation(sim.get(), ss, observer.get(), J);
+    }
   }
   else {
     AppWin appWin(imgui_guard::gImgg(), J);
@@ -86,8 +276,20 @@ int main(int argc, const char* argv[])
         arg_config = std::filesystem::absolute(arg_config);
     } 
 
+    // resume from checkpoint, requires the config the checkpoint was taken from
+    std::filesystem::path arg_restore = "";
+    if (clp.optional("restore", arg_restore)) {
+      arg_restore = std::filesystem::absolute(arg_restore);
+    }
+
+    // re-analyse recorded runs instead of simulating
+    std::filesystem::path arg_replay = "";
+    if (clp.optional("replay", arg_replay)) {
+      arg_replay = std::filesystem::absolute(arg_replay);
+    }
+
     auto J = compose_json(project_dir, arg_config);
-    run(J);
+    run(J, arg_restore, arg_replay);
     return 0;
   }
   catch (const std::exception& err) {
@@ -0,0 +1,105 @@
+// slices of binary observer output (.bin) without conversion
+//
+// dances_query <file.bin> [info] [columns=a,b,..] [t0=T] [t1=T] [id=N] [where=expr;expr..]
+//              [out=file.csv] [precision=N] [threads=N]
+//
+// Selects the rows with t0 <= time <= t1 that satisfy all 'where'
+// predicates (<column><op><value>, op one of == != < <= > >=), id=N is
+// short for where=id==N. The selected columns are written as csv to
+// 'out' or stdout. 'info' prints the file layout.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <tbb/global_control.h>
+#include <libs/cmd_line.h>
+#include <model/analysis/bin_query.hpp>
+#include <model/analysis/bin2csv.hpp>
+
+
+namespace {
+
+  std::vector<std::string> split(const std::string& str, char delim)
+  {
+    std::vector<std::string> res;
+    size_t first = 0;
+    while (first <= str.size()) {
+      const auto last = std::min(str.find(delim, first), str.size());
+      if (last > first) res.push_back(str.substr(first, last - first));
+      first = last + 1;
+    }
+    return res;
+  }
+
+}
+
+
+int main(int argc, const char* argv[])
+{
+  try {
+    if (argc < 2) {
+      std::cerr << "usage: dances_query <file.bin> [info] [columns=a,b,..] [t0=T] [t1=T] [id=N] [where=expr;expr..] [out=file.csv] [precision=N] [threads=N]" << std::endl;
+      return -1;
+    }
+    const auto bin_path = std::filesystem::path(argv[1]);
+    auto clp = cmd::cmd_line_parser(argc - 1, argv + 1);
+    int threads = -1;
+    clp.optional("threads", threads);
+    tbb::global_control gc(tbb::global_control::max_allowed_parallelism, threads > 0 ? threads : tbb::this_task_arena::max_concurrency());
+    const auto bin = analysis::bin::reader(bin_path);
+
+    if (clp.flag("info")) {
+      std::cout << bin_path.string() << '\n'
+                << "  columns:     " << bin.columns() << " (" << bin.header() << ")\n"
+                << "  rows:        " << bin.rows() << '\n'
+                << "  sample_freq: " << bin.sample_freq() << " s\n"
+                << "  time index:  " << bin.index().size() << " entries\n";
+      if (bin.rows()) std::cout << "  time:        " << bin.time(0) << " .. " << bin.time(bin.rows() - 1) << '\n';
+      return 0;
+    }
+
+    analysis::bin::selection sel;
+    std::string header = bin.header();
+    if (std::string columns; clp.optional("columns", columns)) {
+      header.clear();
+      for (const auto& name : split(columns, ',')) {
+        sel.columns.push_back(bin.column(name));
+        header += name + ',';
+      }
+      if (!header.empty()) header.pop_back();
+    }
+    clp.optional("t0", sel.t0);
+    clp.optional("t1", sel.t1);
+    if (std::string id; clp.optional("id", id)) {
+      sel.where.push_back(analysis::bin::parse_predicate(bin, "id==" + id));
+    }
+    if (std::string where; clp.optional("where", where)) {
+      for (const auto& expr : split(where, ';')) {
+        sel.where.push_back(analysis::bin::parse_predicate(bin, expr));
+      }
+    }
+    analysis::bin2csv_options opt;
+    clp.optional("precision", opt.precision);
+
+    std::ofstream ofs;
+    if (std::filesystem::path out; clp.optional("out", out)) {
+      ofs.open(out, std::ios::binary | std::ios::trunc);
+      if (!ofs) throw std::runtime_error("can't open " + out.string());
+    }
+    std::ostream& os = ofs.is_open() ? ofs : std::cout;
+    if (!header.empty()) os << header << '\n';
+    const size_t columns = sel.columns.empty() ? bin.columns() : sel.columns.size();
+    const auto rows = analysis::bin::scan(bin, sel, [&](const float* rows, size_t n) {
+      analysis::format_csv(os, rows, n, columns, opt);
+    });
+    if (!os) throw std::runtime_error("write error");
+    std::cerr << rows << " rows selected" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+  }
+  return -1;
+}
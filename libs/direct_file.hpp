@@ -0,0 +1,174 @@
+#pragma once
+
+// write-only file bypassing the page cache (O_DIRECT / FILE_FLAG_NO_BUFFERING)
+//
+// While direct() is true, buffer addresses, sizes and file offsets passed
+// to write_at must be multiples of block_size. Falls back to buffered I/O
+// where the file system doesn't support direct I/O.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <algorithm>
+#include <string>
+#include <filesystem>
+#include <stdexcept>
+
+#if defined _WIN32
+# include <Windows.h>
+# include <malloc.h>
+#else
+# include <cerrno>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+
+namespace direct_file {
+
+  constexpr size_t block_size = 4096;
+
+  constexpr size_t round_up(size_t bytes) noexcept { return (bytes + block_size - 1) & ~(block_size - 1); }
+
+
+  struct aligned_deleter
+  {
+    void operator()(char* p) const noexcept
+    {
+#ifdef _WIN32
+      _aligned_free(p);
+#else
+      std::free(p);
+#endif
+    }
+  };
+
+  using aligned_buffer = std::unique_ptr<char[], aligned_deleter>;
+
+  // zero initialized, 'bytes' rounded up to block_size
+  inline aligned_buffer make_aligned_buffer(size_t bytes)
+  {
+    bytes = round_up(bytes);
+#ifdef _WIN32
+    auto p = static_cast<char*>(_aligned_malloc(bytes, block_size));
+#else
+    auto p = static_cast<char*>(std::aligned_alloc(block_size, bytes));
+#endif
+    if (!p) throw std::bad_alloc();
+    std::memset(p, 0, bytes);
+    return aligned_buffer(p);
+  }
+
+
+  class writer
+  {
+  public:
+    writer() = default;
+    writer(const writer&) = delete;
+    writer& operator=(const writer&) = delete;
+
+    // creates or truncates 'path'
+    writer(const std::filesystem::path& path, bool direct)
+    {
+      open(path, direct);
+    }
+
+    ~writer() { close(); }
+
+    void open(const std::filesystem::path& path, bool direct)
+    {
+      close();
+      path_ = path;
+#ifdef _WIN32
+      const DWORD flags = FILE_ATTRIBUTE_NORMAL | (direct ? FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH : 0);
+      file_ = CreateFileW(path.wstring().c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, flags, NULL);
+      if (direct && file_ == INVALID_HANDLE_VALUE) {
+        direct = false;
+        file_ = CreateFileW(path.wstring().c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+      }
+      if (file_ == INVALID_HANDLE_VALUE) throw std::runtime_error("can't open " + path.string());
+#else
+      constexpr int mode = O_WRONLY | O_CREAT | O_TRUNC;
+# ifdef O_DIRECT
+      fd_ = direct ? ::open(path.c_str(), mode | O_DIRECT, 0644) : -1;
+      if (fd_ < 0 && direct && errno != EINVAL) throw std::runtime_error("can't open " + path.string());
+# endif
+      if (fd_ < 0) {
+        direct = false;
+        fd_ = ::open(path.c_str(), mode, 0644);
+      }
+      if (fd_ < 0) throw std::runtime_error("can't open " + path.string());
+#endif
+      direct_ = direct;
+    }
+
+    void close() noexcept
+    {
+#ifdef _WIN32
+      if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+      file_ = INVALID_HANDLE_VALUE;
+#else
+      if (fd_ >= 0) ::close(fd_);
+      fd_ = -1;
+#endif
+    }
+
+    // positional write of [buf, buf + bytes)
+    void write_at(const char* buf, size_t bytes, uint64_t ofs)
+    {
+      while (bytes) {
+#ifdef _WIN32
+        OVERLAPPED ov{};
+        ov.Offset = static_cast<DWORD>(ofs);
+        ov.OffsetHigh = static_cast<DWORD>(ofs >> 32);
+        DWORD written = 0;
+        const DWORD n = static_cast<DWORD>(std::min<size_t>(bytes, size_t(1) << 30));
+        if (!WriteFile(file_, buf, n, &written, &ov) || written == 0) throw std::runtime_error("write error " + path_.string());
+#else
+        const auto written = ::pwrite(fd_, buf, bytes, static_cast<off_t>(ofs));
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) throw std::runtime_error("write error " + path_.string());
+#endif
+        buf += written;
+        bytes -= static_cast<size_t>(written);
+        ofs += static_cast<uint64_t>(written);
+      }
+    }
+
+    // sets the file size, e.g. to trim the padding of the last block
+    void truncate(uint64_t size)
+    {
+#ifdef _WIN32
+      FILE_END_OF_FILE_INFO eof{};
+      eof.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+      if (!SetFileInformationByHandle(file_, FileEndOfFileInfo, &eof, sizeof(eof))) throw std::runtime_error("can't truncate " + path_.string());
+#else
+      if (::ftruncate(fd_, static_cast<off_t>(size))) throw std::runtime_error("can't truncate " + path_.string());
+#endif
+    }
+
+    bool is_open() const noexcept
+    {
+#ifdef _WIN32
+      return file_ != INVALID_HANDLE_VALUE;
+#else
+      return fd_ >= 0;
+#endif
+    }
+
+    bool direct() const noexcept { return direct_; }
+    const std::filesystem::path& path() const noexcept { return path_; }
+
+  private:
+    std::filesystem::path path_;
+    bool direct_ = false;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+#else
+    int fd_ = -1;
+#endif
+  };
+
+}
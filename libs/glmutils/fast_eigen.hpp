@@ -149,19 +149,18 @@ namespace glmutils {
   }
 
 
-  //! Returns the Eigenvalues and Eigenvectors of A in increasing order
+  //! Eigenvectors of A for given Eigenvalues
   //!
   //! \param[in] A Argument 3x3 matrix
+  //! \param[in] E The eigenvalues of A in increasing L1-order.
   //! \param[out] EV Matrix of Eigenvectors in the order of their Eigenvalues.
-  //! \return The eigenvalues in increasing L1-order.
   //! \pre \c A must be a symmetric
   //!
   template<typename T>
-  inline tvec3<T> fast_eig(tmat3x3<T> const& A, tmat3x3<T>& EV)
+  inline void fast_eigv(tmat3x3<T> const& A, tvec3<T> const& E, tmat3x3<T>& EV)
   {
     const T eps = std::numeric_limits<T>::epsilon();
     const T epsSqr = eps * eps;
-    const tvec3<T> E = fast_eig(A);
     const T d0 = std::abs(E[2]-E[0]);
     if (d0 < eps) 
     { 
@@ -179,6 +178,21 @@ namespace glmutils {
       T cl = length2(EV[i ^ 1]);
       if (cl > epsSqr) EV[i ^ 1] /= std::sqrt(cl);
     }
+  }
+
+
+  //! Returns the Eigenvalues and Eigenvectors of A in increasing order
+  //!
+  //! \param[in] A Argument 3x3 matrix
+  //! \param[out] EV Matrix of Eigenvectors in the order of their Eigenvalues.
+  //! \return The eigenvalues in increasing L1-order.
+  //! \pre \c A must be a symmetric
+  //!
+  template<typename T>
+  inline tvec3<T> fast_eig(tmat3x3<T> const& A, tmat3x3<T>& EV)
+  {
+    const tvec3<T> E = fast_eig(A);
+    fast_eigv(A, E, EV);
     return E;
   }
 
@@ -0,0 +1,123 @@
+//
+// Utilities for OpenGL Mathematics (glm)
+//
+
+//! \file oobb_batch.hpp Object oriented bounding boxes for many point sets.
+//! \ingroup bbox
+
+
+
+#ifndef glmutils_oobb_batch_hpp
+#define glmutils_oobb_batch_hpp
+
+
+#include <cmath>
+#include <algorithm>
+#include <glmutils/fast_eigen.hpp>
+
+
+namespace glmutils {
+
+  using namespace glm;
+  using namespace glm::detail;
+
+  //! Batched calculation of object oriented bounding boxes by means of PCA.
+  //!
+  //! Point set \c s consists of the points \c [offsets[s], offsets[s+1]).
+  //! Moments are accumulated in a single pass per set, the 3x3 Eigenvalue
+  //! problems are solved across sets in structure-of-arrays blocks.
+  //! Results equal \c oobb() up to rounding of the one-pass covariance,
+  //! thus the points should be given relative to a point of their set.
+  //!
+  //! \param[in] first first point set.
+  //! \param[in] last one past the last point set.
+  //! \param[in] offsets CSR offsets of the point sets.
+  //! \param[in] v the points.
+  //! \param[out] H Homogeneous transformation matrices oobb -> Euclidean, indexed by set.
+  //! \param[out] EXT extends of the OOBBs, indexed by set.
+  //!
+  template<typename T>
+  inline void oobb_batch(unsigned first, unsigned last, const unsigned* offsets, const tvec3<T>* v, tmat4x4<T>* H, tvec3<T>* EXT)
+  {
+    constexpr unsigned W = 16;
+    T sx[W], sy[W], sz[W], sxx[W], syy[W], szz[W], sxy[W], sxz[W], syz[W];
+    T l0[W], l1[W], l2[W];
+    for (unsigned b = first; b < last; b += W)
+    {
+      const unsigned m = std::min(W, last - b);
+
+      // raw moments, one pass per set
+      for (unsigned k = 0; k < W; ++k)
+      {
+        sx[k] = sy[k] = sz[k] = sxx[k] = syy[k] = szz[k] = sxy[k] = sxz[k] = syz[k] = T(0);
+      }
+      for (unsigned k = 0; k < m; ++k)
+      {
+        T ax(0), ay(0), az(0), axx(0), ayy(0), azz(0), axy(0), axz(0), ayz(0);
+        for (unsigned i = offsets[b + k]; i < offsets[b + k + 1]; ++i)
+        {
+          const T x = v[i].x, y = v[i].y, z = v[i].z;
+          ax += x; ay += y; az += z;
+          axx += x * x; ayy += y * y; azz += z * z;
+          axy += x * y; axz += x * z; ayz += y * z;
+        }
+        const T scale = T(1) / T(offsets[b + k + 1] - offsets[b + k]);
+        sx[k] = ax * scale; sy[k] = ay * scale; sz[k] = az * scale;
+        sxx[k] = axx * scale - sx[k] * sx[k];
+        syy[k] = ayy * scale - sy[k] * sy[k];
+        szz[k] = azz * scale - sz[k] * sz[k];
+        sxy[k] = axy * scale - sx[k] * sy[k];
+        sxz[k] = axz * scale - sx[k] * sz[k];
+        syz[k] = ayz * scale - sy[k] * sz[k];
+      }
+
+      // Eigenvalues of the covariance matrices, see fast_eig()
+      for (unsigned k = 0; k < W; ++k)
+      {
+        const T mt = (sxx[k] + syy[k] + szz[k]) / T(3);
+        const T a00 = sxx[k] - mt, a11 = syy[k] - mt, a22 = szz[k] - mt;
+        const T a01 = sxy[k], a02 = sxz[k], a12 = syz[k];
+        const T det = a00 * (a11 * a22 - a12 * a12) - a01 * (a01 * a22 - a12 * a02) + a02 * (a01 * a12 - a11 * a02);
+        const T q = det / T(2);
+        const T p = (a00 * a00 + a11 * a11 + a22 * a22 + T(2) * (a01 * a01 + a02 * a02 + a12 * a12)) / T(6);
+        const T r = std::max(T(0), p * p * p - q * q);
+        const T phi = std::atan2(std::sqrt(r), q) / T(3);
+        const T a = std::sqrt(p);
+        const T cb = std::cos(phi);
+        const T cs = std::sqrt(T(3)) * std::sin(phi);
+        l0[k] = mt - a * (cb + cs);
+        l1[k] = mt - a * (cb - cs);
+        l2[k] = mt + T(2) * a * cb;
+      }
+
+      // Eigenvectors and projection, per set
+      for (unsigned k = 0; k < m; ++k)
+      {
+        const tmat3x3<T> A(tvec3<T>(sxx[k], sxy[k], sxz[k]), tvec3<T>(sxy[k], syy[k], syz[k]), tvec3<T>(sxz[k], syz[k], szz[k]));
+        const tvec3<T> E = detail::abs_rank(tvec3<T>(l0[k], l1[k], l2[k]));
+        tmat3x3<T> EV;
+        fast_eigv(A, E, EV);
+        const unsigned i0 = offsets[b + k];
+        const unsigned i1 = offsets[b + k + 1];
+        tvec3<T> p0 = v[i0] * EV;
+        tvec3<T> p1 = p0;
+        for (unsigned i = i0 + 1; i < i1; ++i)
+        {
+          const tvec3<T> p = v[i] * EV;
+          p0 = tvec3<T>(std::min(p0.x, p.x), std::min(p0.y, p.y), std::min(p0.z, p.z));
+          p1 = tvec3<T>(std::max(p1.x, p.x), std::max(p1.y, p.y), std::max(p1.z, p.z));
+        }
+        EXT[b + k] = p1 - p0;
+        tmat4x4<T>& h = H[b + k];
+        h = tmat4x4<T>(EV);
+        const tvec3<T> gc = EV * (p0 + (p1 - p0) / T(2));
+        for (int i = 0; i < 3; ++i) h[3][i] = gc[i];
+      }
+    }
+  }
+
+
+}   // namespace glmutils
+
+
+#endif  // glmutils_oobb_batch_hpp
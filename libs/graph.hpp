@@ -7,6 +7,9 @@
 #include <vector>
 #include <stack>
 #include <queue>
+#include <atomic>
+#include <memory>
+#include <iterator>
 #include <tbb/tbb.h>
 
 
@@ -87,47 +90,174 @@ namespace graph {
   }
 
 
-  // calls fun for each visited vertex, including pivot
-  template <typename Value, typename Visited, typename Pred, typename Fun>
-  void parallel_bfs(Value pivot, Value begin, Value first, Value last, Visited& visited, Pred pred, Fun fun)
+  // lock-free union-find over [0, n).
+  // Roots are linked to the smaller index, thus the root of a set is its
+  // minimum element. find() uses path halving.
+  class concurrent_disjoint_set
   {
-    tbb::concurrent_queue<Value> queue;
-    queue.push(pivot);
-    Value s;
-    while (queue.try_pop(s))
+  public:
+    concurrent_disjoint_set() = default;
+    explicit concurrent_disjoint_set(size_t n) { reset(n); }
+    concurrent_disjoint_set(concurrent_disjoint_set&&) = default;
+    concurrent_disjoint_set& operator=(concurrent_disjoint_set&&) = default;
+
+    concurrent_disjoint_set(const concurrent_disjoint_set& rhs) { *this = rhs; }
+
+    concurrent_disjoint_set& operator=(const concurrent_disjoint_set& rhs)
     {
-      fun(s);
-      visited[static_cast<size_t>(pivot) - begin] = true;
-      tbb::parallel_for(tbb::blocked_range<Value>(first, last, 128), [&](const auto& r)
-      {
-        for (auto i = r.begin(); i < r.end(); ++i)
-        {
-          if (!visited[static_cast<size_t>(i) - begin] && pred(s, i))
-          {
-            visited[static_cast<size_t>(i) - begin] = true;
-            queue.push(i);
-          }
-        }
-      }, tbb::simple_partitioner{});
+      if (this != &rhs) {
+        reset(rhs.n_);
+        for (size_t i = 0; i < n_; ++i) parent_[i].store(rhs.parent_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+      }
+      return *this;
+    }
+
+    void reset(size_t n)
+    {
+      if (n > capacity_) {
+        parent_.reset(new std::atomic<unsigned>[n]);
+        capacity_ = n;
+      }
+      n_ = n;
+      for (size_t i = 0; i < n; ++i) parent_[i].store(static_cast<unsigned>(i), std::memory_order_relaxed);
+    }
+
+    size_t size() const noexcept { return n_; }
+
+    unsigned find(unsigned x) noexcept
+    {
+      for (;;) {
+        auto p = parent_[x].load(std::memory_order_relaxed);
+        if (p == x) return x;
+        const auto gp = parent_[p].load(std::memory_order_relaxed);
+        if (p != gp) parent_[x].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+        x = gp;
+      }
+    }
+
+    // returns true if a and b were in different sets
+    bool unite(unsigned a, unsigned b) noexcept
+    {
+      for (;;) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return false;
+        if (a > b) std::swap(a, b);
+        auto expected = b;
+        if (parent_[b].compare_exchange_strong(expected, a, std::memory_order_relaxed)) return true;
+      }
+    }
+
+    bool is_root(unsigned x) const noexcept { return parent_[x].load(std::memory_order_relaxed) == x; }
+
+  private:
+    std::unique_ptr<std::atomic<unsigned>[]> parent_;
+    size_t capacity_ = 0;
+    size_t n_ = 0;
+  };
+
+
+  constexpr unsigned no_label = static_cast<unsigned>(-1);
+
+
+  // numbers the sets of ds in ascending order of their minimum element,
+  // label[i] = set of element i or no_label if !include(i).
+  // Returns the number of sets.
+  template <typename Include>
+  unsigned label_sets(concurrent_disjoint_set& ds, std::vector<unsigned>& label, Include include)
+  {
+    const auto n = static_cast<unsigned>(ds.size());
+    label.assign(n, no_label);
+    unsigned sets = 0;
+    for (unsigned i = 0; i < n; ++i) {
+      if (ds.is_root(i) && include(i)) label[i] = sets++;
+    }
+    tbb::parallel_for(tbb::blocked_range<unsigned>(0, n, 1024), [&](const auto& r) {
+      for (auto i = r.begin(); i < r.end(); ++i) {
+        if (!ds.is_root(i) && include(i)) label[i] = label[ds.find(i)];
+      }
+    });
+    return sets;
+  }
+
+
+  inline unsigned label_sets(concurrent_disjoint_set& ds, std::vector<unsigned>& label)
+  {
+    return label_sets(ds, label, [](unsigned) { return true; });
+  }
+
+
+  // components from labels, members in ascending order
+  template <typename Value = unsigned>
+  components_t<Value> gather_components(const std::vector<unsigned>& label, unsigned sets, Value first = Value(0))
+  {
+    components_t<Value> cc(sets);
+    for (unsigned i = 0; i < static_cast<unsigned>(label.size()); ++i) {
+      if (label[i] != no_label) cc[label[i]].push_back(first + static_cast<Value>(i));
     }
+    return cc;
   }
 
 
+  // connected components of the graph over [0, n) given by an edge list.
+  // Edges: random access range of pair-like {first, second}.
+  // Components are ordered by their minimum vertex.
+  template <typename Edges>
+  components_t<unsigned> connected_components_from_edges(size_t n, const Edges& edges)
+  {
+    concurrent_disjoint_set ds(n);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, std::size(edges), 4096), [&](const auto& r) {
+      for (auto e = r.begin(); e < r.end(); ++e) {
+        const auto& edge = edges[e];
+        ds.unite(static_cast<unsigned>(edge.first), static_cast<unsigned>(edge.second));
+      }
+    });
+    std::vector<unsigned> label;
+    const auto sets = label_sets(ds, label);
+    return gather_components(label, sets);
+  }
+
+
+  // connected components of the graph over [0, n) given by candidate pairs:
+  // candidates(i, visit) calls visit(j) for potential neighbors j of i,
+  // pred(i, j) confirms the edge.
+  // Components are ordered by their minimum vertex.
+  template <typename Candidates, typename Pred>
+  components_t<unsigned> connected_components_from_candidates(size_t n, Candidates candidates, Pred pred)
+  {
+    concurrent_disjoint_set ds(n);
+    tbb::parallel_for(tbb::blocked_range<unsigned>(0, static_cast<unsigned>(n), 256), [&](const auto& r) {
+      for (auto i = r.begin(); i < r.end(); ++i) {
+        candidates(i, [&](unsigned j) {
+          if (j != i && pred(i, j)) ds.unite(i, j);
+        });
+      }
+    });
+    std::vector<unsigned> label;
+    const auto sets = label_sets(ds, label);
+    return gather_components(label, sets);
+  }
+
+
+  // all-pairs variant of connected_components, parallel.
+  // Same components and order as connected_components, members in ascending order.
   template <typename Value, typename Pred>
   auto parallel_connected_components(Value first, Value last, Pred pred)
   {
-    components_t<Value> cc;
-    std::vector<int> visited(static_cast<size_t>(last) - first, false);
-    for (auto i = first; i < last - 1; ++i)
-    {
-      if (!visited[static_cast<size_t>(i) - first])
-      {
-        component_t<Value> c;
-        parallel_bfs(i, first, i + 1, last, visited, pred, [&c](auto x) { c.push_back(x); });
-        cc.emplace_back(std::move(c));
+    const auto n = static_cast<size_t>(last - first);
+    concurrent_disjoint_set ds(n);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, n, 16), [&](const auto& r) {
+      for (auto i = r.begin(); i < r.end(); ++i) {
+        for (auto j = i + 1; j < n; ++j) {
+          if (pred(first + static_cast<Value>(i), first + static_cast<Value>(j))) {
+            ds.unite(static_cast<unsigned>(i), static_cast<unsigned>(j));
+          }
+        }
       }
-    }
-    return cc;
+    });
+    std::vector<unsigned> label;
+    const auto sets = label_sets(ds, label);
+    return gather_components<Value>(label, sets, first);
   }
 
 
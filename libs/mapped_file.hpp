@@ -0,0 +1,118 @@
+#pragma once
+
+// read-only memory mapped file
+
+#include <cstddef>
+#include <string>
+#include <filesystem>
+#include <stdexcept>
+
+#if defined _WIN32
+# include <Windows.h>
+#else
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+#endif
+
+
+namespace mapped_file {
+
+  class reader
+  {
+  public:
+    reader() = default;
+    reader(const reader&) = delete;
+    reader& operator=(const reader&) = delete;
+
+    explicit reader(const std::filesystem::path& path)
+    {
+      open(path);
+    }
+
+    reader(reader&& rhs) noexcept { swap(rhs); }
+    reader& operator=(reader&& rhs) noexcept { close(); swap(rhs); return *this; }
+
+    ~reader() { close(); }
+
+    void open(const std::filesystem::path& path)
+    {
+      close();
+#ifdef _WIN32
+      file_ = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+      if (file_ == INVALID_HANDLE_VALUE) throw std::runtime_error("can't open " + path.string());
+      LARGE_INTEGER fs;
+      GetFileSizeEx(file_, &fs);
+      size_ = static_cast<size_t>(fs.QuadPart);
+      if (size_) {
+        map_ = CreateFileMappingW(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (map_ == NULL) throw std::runtime_error("can't map " + path.string());
+        data_ = static_cast<const char*>(MapViewOfFile(map_, FILE_MAP_READ, 0, 0, 0));
+      }
+#else
+      fd_ = ::open(path.c_str(), O_RDONLY);
+      if (fd_ < 0) throw std::runtime_error("can't open " + path.string());
+      struct stat st;
+      ::fstat(fd_, &st);
+      size_ = static_cast<size_t>(st.st_size);
+      if (size_) {
+        void* p = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+        if (p == MAP_FAILED) throw std::runtime_error("can't map " + path.string());
+        data_ = static_cast<const char*>(p);
+        ::madvise(p, size_, MADV_WILLNEED);
+      }
+#endif
+    }
+
+    void close() noexcept
+    {
+#ifdef _WIN32
+      if (data_) UnmapViewOfFile(data_);
+      if (map_ != NULL) CloseHandle(map_);
+      if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+      map_ = NULL;
+      file_ = INVALID_HANDLE_VALUE;
+#else
+      if (data_) ::munmap(const_cast<char*>(data_), size_);
+      if (fd_ >= 0) ::close(fd_);
+      fd_ = -1;
+#endif
+      data_ = nullptr;
+      size_ = 0;
+    }
+
+    const char* data() const noexcept { return data_; }
+    const char* begin() const noexcept { return data_; }
+    const char* end() const noexcept { return data_ + size_; }
+    size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+
+    // typed view starting at byte offset 'ofs'
+    template <typename T>
+    const T* as(size_t ofs = 0) const noexcept { return reinterpret_cast<const T*>(data_ + ofs); }
+
+  private:
+    void swap(reader& rhs) noexcept
+    {
+      std::swap(data_, rhs.data_);
+      std::swap(size_, rhs.size_);
+#ifdef _WIN32
+      std::swap(file_, rhs.file_);
+      std::swap(map_, rhs.map_);
+#else
+      std::swap(fd_, rhs.fd_);
+#endif
+    }
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE map_ = NULL;
+#else
+    int fd_ = -1;
+#endif
+  };
+
+}
@@ -0,0 +1,110 @@
+// uniform grid spatial hash for fixed radius neighbor queries
+
+#ifndef SPATIAL_HASH_HPP_INCLUDED
+#define SPATIAL_HASH_HPP_INCLUDED
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <tbb/tbb.h>
+
+
+namespace spatial_hash {
+
+
+  class grid
+  {
+  public:
+    // builds the hash over n points, pos(i) -> glm::vec3
+    template <typename Pos>
+    void build(size_t n, float cell_size, Pos pos)
+    {
+      inv_cell_ = 1.f / cell_size;
+      size_t buckets = 64;
+      while (buckets < 2 * n) buckets <<= 1;
+      mask_ = buckets - 1;
+      key_.resize(n);
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, n, 1024), [&](const auto& r) {
+        for (auto i = r.begin(); i < r.end(); ++i) {
+          key_[i] = static_cast<unsigned>(bucket(cell(pos(i))));
+        }
+      });
+      // counting sort by bucket, ascending index within a bucket
+      start_.assign(buckets + 1, 0);
+      for (size_t i = 0; i < n; ++i) ++start_[key_[i] + 1];
+      for (size_t b = 0; b < buckets; ++b) start_[b + 1] += start_[b];
+      entries_.resize(n);
+      fill_ = start_;
+      for (size_t i = 0; i < n; ++i) entries_[fill_[key_[i]]++] = static_cast<unsigned>(i);
+    }
+
+    // calls fun(j) for all points j in the cell of p and its 26 neighbors.
+    // Superset of the points within cell_size, hash collisions included.
+    template <typename Fun>
+    void visit_neighbors(const glm::vec3& p, Fun&& fun) const
+    {
+      const auto c = cell(p);
+      size_t visited[27];
+      int nv = 0;
+      for (int dz = -1; dz <= 1; ++dz) {
+        for (int dy = -1; dy <= 1; ++dy) {
+          for (int dx = -1; dx <= 1; ++dx) {
+            const auto b = bucket(c + glm::ivec3(dx, dy, dz));
+            if (std::find(visited, visited + nv, b) != visited + nv) continue;   // collision
+            visited[nv++] = b;
+            for (auto e = start_[b]; e < start_[b + 1]; ++e) {
+              fun(entries_[e]);
+            }
+          }
+        }
+      }
+    }
+
+    // calls fun(j) for all points j in the cells at Chebyshev distance 'ring'
+    // from the cell of p. Colliding buckets may be visited more than once.
+    template <typename Fun>
+    void visit_ring(const glm::vec3& p, int ring, Fun&& fun) const
+    {
+      const auto c = cell(p);
+      for (int dz = -ring; dz <= ring; ++dz) {
+        for (int dy = -ring; dy <= ring; ++dy) {
+          const bool face = (std::abs(dz) == ring) || (std::abs(dy) == ring);
+          for (int dx = -ring; dx <= ring; dx += (face || ring == 0) ? 1 : 2 * ring) {
+            const auto b = bucket(c + glm::ivec3(dx, dy, dz));
+            for (auto e = start_[b]; e < start_[b + 1]; ++e) {
+              fun(entries_[e]);
+            }
+          }
+        }
+      }
+    }
+
+    float cell_size() const noexcept { return 1.f / inv_cell_; }
+
+  private:
+    glm::ivec3 cell(const glm::vec3& p) const noexcept
+    {
+      return glm::ivec3(std::floor(p.x * inv_cell_), std::floor(p.y * inv_cell_), std::floor(p.z * inv_cell_));
+    }
+
+    size_t bucket(const glm::ivec3& c) const noexcept
+    {
+      const auto h = (static_cast<uint64_t>(static_cast<uint32_t>(c.x)) * 73856093u)
+                   ^ (static_cast<uint64_t>(static_cast<uint32_t>(c.y)) * 19349663u)
+                   ^ (static_cast<uint64_t>(static_cast<uint32_t>(c.z)) * 83492791u);
+      return static_cast<size_t>(h) & mask_;
+    }
+
+    float inv_cell_ = 1.f;
+    size_t mask_ = 0;
+    std::vector<unsigned> key_;       // bucket of point
+    std::vector<unsigned> start_;     // bucket -> first entry
+    std::vector<unsigned> fill_;
+    std::vector<unsigned> entries_;   // point indices sorted by bucket
+  };
+
+}
+
+#endif
@@ -228,7 +228,7 @@ namespace model {
 				self->target = -1;
 				if (it != groups.cend()) {
 					const auto group_id = static_cast<size_t>(std::distance(groups.cbegin(), it));
-					self->target = sim.group_mates<prey_tag>(group_id)[0];
+					self->target = sim.group_members<prey_tag>(group_id).front();
 				}
 			}
 
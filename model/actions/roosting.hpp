@@ -31,9 +31,10 @@ namespace model {
 				//const auto& thisflock = sim.flocks<Tag>()[fl_id];
 
 				// homing position relative to its flock current position
-				const auto& this_flock = sim.groups<Tag>()[sim.group_of<Tag>(idx)];
-				const auto& flock_pos = this_flock.gc();
-				const auto& flock_head = math::save_normalize(this_flock.vel, vec3(0.f));
+				// (own position and heading before the first group detection)
+				const auto fl_id = sim.group_of<Tag>(idx);
+				const auto flock_pos = (fl_id >= 0) ? sim.groups<Tag>()[fl_id].gc() : self->pos;
+				const auto flock_head = (fl_id >= 0) ? math::save_normalize(sim.groups<Tag>()[fl_id].vel, vec3(0.f)) : self->dir;
 				home_pos_ = flock_pos + math::rotate(flock_head, angl_to_home_, self->H.up());
 			}
 
@@ -70,9 +71,10 @@ namespace model {
 				//const auto& thisflock = sim.flocks<Tag>()[fl_id];
 
 				// homing position relative to its flock current position
-				const auto& this_flock = sim.groups<Tag>()[sim.group_of<Tag>(idx)];
-				const auto& flock_pos = this_flock.gc();
-				const auto& flock_head = math::save_normalize(this_flock.vel, vec3(0.f));
+				// (own position and heading before the first group detection)
+				const auto fl_id = sim.group_of<Tag>(idx);
+				const auto flock_pos = (fl_id >= 0) ? sim.groups<Tag>()[fl_id].gc() : self->pos;
+				const auto flock_head = (fl_id >= 0) ? math::save_normalize(sim.groups<Tag>()[fl_id].vel, vec3(0.f)) : self->dir;
 				home_pos_ = flock_pos + dist_to_home_ * math::rotate(flock_head, angl_to_home_, self->H.up());
 			}
 
@@ -90,6 +90,14 @@ namespace model {
       v0_ = glm::dvec3(agent.speed * agent.dir);
     }
 
+    // sets the frame of a recorded agent
+    template <typename Agent>
+    void replay(const Agent& agent, double beta) {
+      regenerateH(agent.pos, agent.dir);
+      v0_ = glm::dvec3(agent.speed * agent.dir);
+      beta_ = beta;
+    }
+
     template <typename Agent>
     void update(const Agent& agent, float dt) {
       // Hello Newton
@@ -27,7 +27,6 @@ namespace model {
   };
 
 
-  decltype(Pred::transitions_) Pred::transitions_;
   // flight::aero_info<float> Pred::ai;
   //const flight::aero_info<float>& Pred::ai = Pred::ai;
 
@@ -35,7 +34,8 @@ namespace model {
   template <typename Init>
   void do_init_pop(std::vector<agent_instance<pred_tag>>& vse, Init&& init)
   {
-    for (auto& e : vse) init(e);
+    if constexpr (requires { init.fill(vse); }) init.fill(vse);    // bulk initializer
+    else for (auto& e : vse) init(e);
   }  
 
 
@@ -48,6 +48,7 @@ namespace model {
     std::vector<agent_instance<pred_tag>> vse(N);
     if (type == "random") do_init_pop(vse, initial_conditions::random(jic));
     else if (type == "csv") do_init_pop(vse, initial_conditions::from_csv(jic));
+    else if (type == "bin") do_init_pop(vse, initial_conditions::from_bin(jic));
     else throw std::runtime_error("unknown initializer");
     return vse;
   }
@@ -61,7 +62,7 @@ namespace model {
     accel(0) // [m / s^2]
   {
     if (idx == 0) {
-      transitions_ = decltype(transitions_)(J);
+      transitions_ = std::make_shared<const transitions>(J);
     }
     ai = flight::create_aero_info<float>(J["aero"]);
     speed = sa.cruiseSpeed = ai.cruiseSpeed;
@@ -71,6 +72,7 @@ namespace model {
 
   void Pred::initialize(size_t idx, const Simulation& sim, const json& J)
   {
+    if (idx != 0) transitions_ = sim.pop<Tag>()[0].transitions_;
     H.initialize(*this);
     pa_[current_state_]->enter(this, idx, 0, sim, nullptr);
   }
@@ -92,6 +94,31 @@ namespace model {
     dir = se.dir;
   }
 
+  void Pred::replay(const recorded_state& rs) noexcept
+  {
+    pos = rs.pos;
+    dir = rs.dir;
+    speed = rs.speed;
+    current_state_ = rs.state;
+    H.replay(*this, rs.beta);
+  }
+
+  void Pred::save(checkpoint::oarchive& ar) const
+  {
+    ar.pod(pos).pod(dir).pod(H).pod(reaction_time).pod(last_update).pod(copy_duration);
+    ar.pod(speed).pod(accel).pod(steering).pod(target).pod(state_timer).pod(stress).pod(ai).pod(sa);
+    ar.pod(current_state_);
+    for (const auto& s : pa_) s->save(ar);
+  }
+
+  void Pred::load(checkpoint::iarchive& ar)
+  {
+    ar.pod(pos).pod(dir).pod(H).pod(reaction_time).pod(last_update).pod(copy_duration);
+    ar.pod(speed).pod(accel).pod(steering).pod(target).pod(state_timer).pod(stress).pod(ai).pod(sa);
+    ar.pod(current_state_);
+    for (auto& s : pa_) s->load(ar);
+  }
+
   tick_t Pred::update(size_t idx, tick_t T, const Simulation& sim)
   {
     steering = vec3(0);
@@ -110,7 +137,7 @@ namespace model {
   {
     // select new state
     auto& dist = pred_discrete_dist;
-    const auto TM = transitions_(0.f);
+    const auto TM = (*transitions_)(0.f);
     pred_discrete_dist.mutate(TM[current_state_].cbegin(), TM[current_state_].cend());
     const auto next_state = pred_discrete_dist(reng);
     current_state_ = pa_[next_state]->enter(this, idx, T, sim, nullptr);
@@ -1,6 +1,7 @@
 #ifndef PRED_HPP_INCLUDED
 #define PRED_HPP_INCLUDED
 
+#include <memory>
 #include <math.hpp>
 #include <agents/agents.hpp>
 #include <states/transient.hpp>
@@ -43,6 +44,15 @@ namespace model {
     vec3 pos = vec3(0);
     vec3 dir = vec3(0);
 
+    // id, pos.xy, dir
+    static constexpr size_t csv_columns = 6;
+
+    static void from_csv_row(const float* row, agent_instance<pred_tag>& e)
+    {
+      e.pos = vec3(row[1], row[2], 0.f);
+      e.dir = vec3(row[3], row[4], row[5]);
+    }
+
     static std::istream& stream_from_csv(std::istream& is, agent_instance<pred_tag>& e)
     {
       char delim;
@@ -92,6 +102,7 @@ namespace model {
     using transitions = transitions::piecewise_linear_interpolator<AP::transition_matrix, 1>;
 
   public:
+    Pred(const Pred&) = default;
     Pred(Pred&&) = default;
     Pred(size_t idx, const json& J);
     void initialize(size_t idx, const Simulation& sim, const json& J);
@@ -104,6 +115,13 @@ namespace model {
     ::model::instance_proxy instance_proxy(size_t idx, const class Simulation* sim) const noexcept;
     ::model::agent_instance<Tag> get_instance(const Simulation* sim, size_t idx) const noexcept;
     void get_instance(Simulation* sim, size_t idx, const agent_instance<Tag>& se) noexcept;
+
+    // checkpoint support
+    void save(checkpoint::oarchive& ar) const;
+    void load(checkpoint::iarchive& ar);
+
+    // replay support, see Simulation::replay()
+    void replay(const recorded_state& rs) noexcept;
     static std::vector<agent_instance<Tag>> init_pop(const Simulation& sim, const json& J);
 
     // unsynchronized queries used externally 
@@ -130,7 +148,7 @@ namespace model {
 
   private:
     state_info_t current_state_;
-    static transitions transitions_;
+    std::shared_ptr<const transitions> transitions_;    // shared by the agents of a simulation
     AP::package_array pa_;
   };
 
@@ -51,12 +51,11 @@ namespace model {
   };
 
 
-  decltype(Prey::transitions_) Prey::transitions_;
-
   template <typename Init>
   void do_init_pop(std::vector<agent_instance<prey_tag>>& vse, Init&& init)
   {
-    for (auto& e : vse) init(e);
+    if constexpr (requires { init.fill(vse); }) init.fill(vse);    // bulk initializer
+    else for (auto& e : vse) init(e);
   }
 
 
@@ -70,6 +69,7 @@ namespace model {
     if (type == "random") do_init_pop(vse, initial_conditions::random(jic));
     else if (type == "flock") do_init_pop(vse, initial_conditions::in_flock(jic));
     else if (type == "csv") do_init_pop(vse, initial_conditions::from_csv(jic));
+    else if (type == "bin") do_init_pop(vse, initial_conditions::from_bin(jic));
     else throw std::runtime_error("unknown initializer");
     return vse;
   }
@@ -81,7 +81,7 @@ namespace model {
     accel(0) // [m / s^2]
   {
     if (idx == 0) {
-      transitions_ = decltype(transitions_)(J);
+      transitions_ = std::make_shared<const transitions>(J);
     }
 
     pa_ = AP::create(idx, J["states"]);
@@ -105,6 +105,7 @@ namespace model {
 
   void Prey::initialize(size_t idx, const Simulation& sim, const json& J)
   {
+    if (idx != 0) transitions_ = sim.pop<Tag>()[0].transitions_;
     H.initialize(*this);
     pa_[current_state_]->enter(this, idx, 0, sim, nullptr);
   }
@@ -126,6 +127,33 @@ namespace model {
     dir = se.dir;
   }
 
+  void Prey::replay(const recorded_state& rs) noexcept
+  {
+    pos = rs.pos;
+    dir = rs.dir;
+    speed = rs.speed;
+    current_state_ = rs.state;
+    H.replay(*this, rs.beta);
+  }
+
+  void Prey::save(checkpoint::oarchive& ar) const
+  {
+    ar.pod(pos).pod(dir).pod(H).pod(speed).pod(accel).pod(reaction_time).pod(last_update);
+    ar.pod(stress).pod(tm).pod(steering).pod(copied_state).pod(prev_exit_dir).pod(ai).pod(sa);
+    ar.pod(current_state_).pod(stress_ofs_).pod(stress_decay_);
+    std::apply([&](const auto&... src) { (ar.pod(src), ...); }, sp_);
+    for (const auto& s : pa_) s->save(ar);
+  }
+
+  void Prey::load(checkpoint::iarchive& ar)
+  {
+    ar.pod(pos).pod(dir).pod(H).pod(speed).pod(accel).pod(reaction_time).pod(last_update);
+    ar.pod(stress).pod(tm).pod(steering).pod(copied_state).pod(prev_exit_dir).pod(ai).pod(sa);
+    ar.pod(current_state_).pod(stress_ofs_).pod(stress_decay_);
+    std::apply([&](auto&... src) { (ar.pod(src), ...); }, sp_);
+    for (auto& s : pa_) s->load(ar);
+  }
+
   tick_t Prey::update(size_t idx, tick_t T, const Simulation& sim)
   {
     steering = vec3(0);
@@ -153,7 +181,7 @@ namespace model {
       current_state_ = pa_[copied_state]->enter(this, idx, T, sim, &copied_state);
     }
     else {
-      const auto TM = transitions_(stress);
+      const auto TM = (*transitions_)(stress);
       prey_discrete_dist.mutate(TM[current_state_].cbegin(), TM[current_state_].cend());
       auto next_state = prey_discrete_dist(reng);
       current_state_ = pa_[next_state]->enter(this, idx, T, sim, nullptr);
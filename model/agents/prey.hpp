@@ -4,6 +4,7 @@
 #include <istream>
 #include <ostream>
 #include <optional>
+#include <memory>
 #include <model/json.hpp>
 #include <model/math.hpp>
 #include <glmutils/random.hpp>
@@ -57,6 +58,15 @@ namespace model {
     vec3 pos = vec3(0);
     vec3 dir = vec3(0);
 
+    // id, pos, dir
+    static constexpr size_t csv_columns = 7;
+
+    static void from_csv_row(const float* row, agent_instance<prey_tag>& e)
+    {
+      e.pos = vec3(row[1], row[2], row[3]);
+      e.dir = vec3(row[4], row[5], row[6]);
+    }
+
     static std::istream& stream_from_csv(std::istream& is, agent_instance<prey_tag>& e)
     {
       char delim;
@@ -127,6 +137,7 @@ namespace model {
     using transitions = transitions::piecewise_linear_interpolator<AP::transition_matrix, 3>; // based on transition cuts of interpolation
 
   public:
+    Prey(const Prey&) = default;
     Prey(Prey&&) = default;
     Prey(size_t idx, const json& J);
 
@@ -141,6 +152,13 @@ namespace model {
     ::model::instance_proxy instance_proxy(size_t idx, const Simulation* sim) const noexcept;
     ::model::agent_instance<Tag> get_instance(const Simulation* sim, size_t idx) const noexcept;
     void get_instance(Simulation* sim, size_t idx, const agent_instance<Tag>& se) noexcept;
+
+    // checkpoint support
+    void save(checkpoint::oarchive& ar) const;
+    void load(checkpoint::iarchive& ar);
+
+    // replay support, see Simulation::replay()
+    void replay(const recorded_state& rs) noexcept;
   //  float assess_current_state(size_t idx, const Simulation* sim) const noexcept { return pa_[current_state_.state()]->assess_substate(this, idx, T, sim, i);; };
 
     // unsynchronized queries used externally
@@ -172,7 +190,7 @@ namespace model {
 
   private:
     state_info_t current_state_;
-    static transitions transitions_;
+    std::shared_ptr<const transitions> transitions_;    // shared by the agents of a simulation
     float stress_ofs_; // stress offset (individual variation)
     float stress_decay_; // same of all prey
 
@@ -208,6 +226,9 @@ namespace model {
         return escape_state;
       }
 
+      void save(checkpoint::oarchive& ar) const { ar.pod(probs); }
+      void load(checkpoint::iarchive& ar) { ar.pod(probs); }
+
       // it is possible to have multiple specializations
       // size_t operator()(typename Prey::other_multi_state& ...)
 
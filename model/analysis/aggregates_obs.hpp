@@ -0,0 +1,275 @@
+#ifndef AGGREGATES_OBS_HPP_INCLUDED
+#define AGGREGATES_OBS_HPP_INCLUDED
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+#include <model/observer.hpp>
+#include <agents/agents.hpp>
+
+
+namespace analysis {
+
+  namespace aggregates {
+
+    // per-agent quantities
+    enum class quantity { speed, nnd, stress, state, dist2gc, altitude };
+
+    inline quantity parse_quantity(const std::string& name)
+    {
+      static const std::pair<const char*, quantity> names[] = {
+        { "speed", quantity::speed }, { "nnd", quantity::nnd }, { "stress", quantity::stress },
+        { "state", quantity::state }, { "dist2gc", quantity::dist2gc }, { "altitude", quantity::altitude },
+      };
+      for (const auto& [n, q] : names) {
+        if (name == n) return q;
+      }
+      throw std::runtime_error("Aggregates: unknown quantity '" + name + "'");
+    }
+
+
+    enum class stat { mean, var, sd, min, max };
+
+    inline stat parse_stat(const std::string& name)
+    {
+      static const std::pair<const char*, stat> names[] = {
+        { "mean", stat::mean }, { "var", stat::var }, { "sd", stat::sd }, { "min", stat::min }, { "max", stat::max },
+      };
+      for (const auto& [n, s] : names) {
+        if (name == n) return s;
+      }
+      throw std::runtime_error("Aggregates: unknown statistic '" + name + "'");
+    }
+
+
+    // count, mean, sum of squared deviations, min, max; mergeable (Chan et al.)
+    struct moments
+    {
+      double n = 0, mean = 0, m2 = 0;
+      float min = std::numeric_limits<float>::max();
+      float max = -std::numeric_limits<float>::max();
+
+      void add(float x) noexcept
+      {
+        n += 1;
+        const double d = x - mean;
+        mean += d / n;
+        m2 += d * (x - mean);
+        min = std::min(min, x);
+        max = std::max(max, x);
+      }
+
+      void merge(const moments& rhs) noexcept
+      {
+        if (rhs.n == 0) return;
+        const double nn = n + rhs.n;
+        const double d = rhs.mean - mean;
+        mean += d * rhs.n / nn;
+        m2 += rhs.m2 + d * d * n * rhs.n / nn;
+        n = nn;
+        min = std::min(min, rhs.min);
+        max = std::max(max, rhs.max);
+      }
+
+      double var() const noexcept { return (n > 1) ? m2 / (n - 1) : 0.0; }
+    };
+
+
+    // statistics of one quantity
+    struct column
+    {
+      quantity q;
+      std::string name;
+      std::vector<stat> stats;
+      std::vector<float> quantiles;     // ascending, [0, 1]
+      size_t bins = 0;                  // histogram, 0: none
+      float lo = 0.f, hi = 1.f;         // histogram range, outliers go to the edge bins
+
+      size_t size() const noexcept { return stats.size() + quantiles.size() + bins; }
+
+      // "<name>_<stat>", "<name>_q<percent>", "<name>_h<bin>"
+      std::string header() const
+      {
+        static const char* stat_names[] = { "mean", "var", "sd", "min", "max" };
+        std::string h;
+        for (auto s : stats) h += ',' + name + '_' + stat_names[size_t(s)];
+        for (auto p : quantiles) {
+          std::ostringstream os;
+          os << p * 100;
+          auto str = os.str();
+          std::replace(str.begin(), str.end(), '.', '_');
+          h += ',' + name + "_q" + str;
+        }
+        for (size_t b = 0; b < bins; ++b) h += ',' + name + "_h" + std::to_string(b);
+        return h;
+      }
+
+      // appends the statistics of [x, x + n), reorders x
+      void reduce(float* x, size_t n, float* out) const
+      {
+        constexpr size_t grain = 4096;
+        if (!stats.empty()) {
+          const auto m = tbb::parallel_reduce(tbb::blocked_range<size_t>(0, n, grain), moments{},
+            [&](const tbb::blocked_range<size_t>& r, moments m) {
+              for (size_t i = r.begin(); i < r.end(); ++i) m.add(x[i]);
+              return m;
+            },
+            [](moments a, const moments& b) { a.merge(b); return a; });
+          for (auto s : stats) {
+            switch (s) {
+              case stat::mean: *out++ = float(m.mean); break;
+              case stat::var: *out++ = float(m.var()); break;
+              case stat::sd: *out++ = float(std::sqrt(m.var())); break;
+              case stat::min: *out++ = n ? m.min : 0.f; break;
+              case stat::max: *out++ = n ? m.max : 0.f; break;
+            }
+          }
+        }
+        if (bins) {
+          const auto counts = tbb::parallel_reduce(tbb::blocked_range<size_t>(0, n, grain), std::vector<size_t>(bins, 0),
+            [&](const tbb::blocked_range<size_t>& r, std::vector<size_t> c) {
+              const float scale = bins / (hi - lo);
+              for (size_t i = r.begin(); i < r.end(); ++i) {
+                const auto b = static_cast<ptrdiff_t>(std::floor((x[i] - lo) * scale));
+                ++c[std::clamp<ptrdiff_t>(b, 0, bins - 1)];
+              }
+              return c;
+            },
+            [](std::vector<size_t> a, const std::vector<size_t>& b) {
+              for (size_t i = 0; i < a.size(); ++i) a[i] += b[i];
+              return a;
+            });
+          for (size_t b = 0; b < bins; ++b) out[quantiles.size() + b] = n ? float(double(counts[b]) / n) : 0.f;
+        }
+        // exact quantiles by successive selection (lower order statistic)
+        size_t first = 0;
+        for (auto p : quantiles) {
+          if (n == 0) {
+            *out++ = 0.f;
+            continue;
+          }
+          const auto k = std::min(n - 1, static_cast<size_t>(p * (n - 1) + 0.5));
+          std::nth_element(x + first, x + k, x + n);
+          *out++ = x[k];
+          first = k;
+        }
+      }
+    };
+
+
+    inline std::vector<column> parse_columns(const json& J)
+    {
+      std::vector<column> res;
+      for (const auto& [key, jc] : J["columns"].items()) {
+        column c;
+        c.q = parse_quantity(key);
+        c.name = key;
+        for (const std::string& s : optional_json<std::vector<std::string>>(jc, "stats").value_or(std::vector<std::string>{})) {
+          c.stats.push_back(parse_stat(s));
+        }
+        c.quantiles = optional_json<std::vector<float>>(jc, "quantiles").value_or(std::vector<float>{});
+        for (auto p : c.quantiles) {
+          if (p < 0.f || p > 1.f) throw std::runtime_error("Aggregates: quantile out of [0, 1] for '" + key + "'");
+        }
+        std::sort(c.quantiles.begin(), c.quantiles.end());
+        if (jc.contains("hist")) {
+          const auto& jh = jc["hist"];
+          c.lo = jh["min"];
+          c.hi = jh["max"];
+          c.bins = jh["bins"];
+          if (c.bins == 0 || !(c.hi > c.lo)) throw std::runtime_error("Aggregates: invalid histogram for '" + key + "'");
+        }
+        res.push_back(std::move(c));
+      }
+      return res;
+    }
+
+
+    // the configuration with the generated "header"
+    inline json with_header(json J)
+    {
+      std::string header = "time,N";
+      for (const auto& c : parse_columns(J)) header += c.header();
+      J["header"] = header;
+      return J;
+    }
+
+  }
+
+
+  // Per-sample population statistics, configured per quantity:
+  // "columns": { "speed": { "stats": ["mean", "var", "sd", "min", "max"], "quantiles": [0.5, 0.9],
+  //                         "hist": { "min": 0, "max": 30, "bins": 15 } }, ... }
+  // Quantities: speed, nnd, stress, state, dist2gc, altitude. One row per sample:
+  // time, N, then per quantity its stats, quantiles and bin fractions.
+  template <typename Tag>
+  class AggregatesObserver : public model::AnalysisObserver
+  {
+  public:
+    AggregatesObserver(const std::filesystem::path& out_path, const json& J) :
+      AnalysisObserver(out_path, aggregates::with_header(J)),
+      columns_(aggregates::parse_columns(J))
+    {
+      for (const auto& c : columns_) need_nnd_ = need_nnd_ || (c.q == aggregates::quantity::nnd);
+    }
+
+  protected:
+    void notify_collect(const model::Simulation& sim) override
+    {
+      using aggregates::quantity;
+      const size_t N = sim.pop<Tag>().size();
+      const size_t Q = columns_.size();
+      values_.resize(Q * N);
+      if (need_nnd_) sim.nearest_neighbors<Tag>(1, knn_);
+      sim.parallel_visit_all<Tag>([&](auto& p, size_t idx) {
+        for (size_t c = 0; c < Q; ++c) {
+          float x = 0.f;
+          switch (columns_[c].q) {
+            case quantity::speed: x = p.speed; break;
+            case quantity::nnd: x = (N > 1) ? std::sqrt(knn_[idx].dist2) : 0.f; break;
+            case quantity::stress: x = p.stress; break;
+            case quantity::state: x = static_cast<float>(p.get_current_state().state()); break;
+            case quantity::dist2gc: {
+              const auto g = sim.group_of<Tag>(idx);
+              x = (g >= 0) ? glm::distance(p.pos, sim.groups<Tag>()[g].gc()) : 0.f;
+              break;
+            }
+            case quantity::altitude: x = p.pos.y; break;
+          }
+          values_[c * N + idx] = x;
+        }
+      });
+      const auto first = data_out_.size();
+      data_out_.resize(first + AnalysisObserver::columns(), 0.f);
+      float* row = data_out_.data() + first;
+      row[0] = static_cast<float>(sim.tick()) * model::Simulation::dt();
+      row[1] = static_cast<float>(N);
+      offsets_.resize(Q);
+      for (size_t c = 0, ofs = 2; c < Q; ofs += columns_[c].size(), ++c) offsets_[c] = ofs;
+      tbb::parallel_for(size_t(0), Q, [&](size_t c) {
+        columns_[c].reduce(values_.data() + c * N, N, row + offsets_[c]);
+      });
+    }
+
+    void notify_save(const model::Simulation& sim) override
+    {
+      exporter_.submit(data_out_);
+    }
+
+  private:
+    std::vector<aggregates::column> columns_;
+    std::vector<size_t> offsets_;
+    std::vector<float> values_;               // [column][agent]
+    std::vector<model::neighbor_info> knn_;
+    bool need_nnd_ = false;
+  };
+
+}
+
+#endif
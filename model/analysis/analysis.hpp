@@ -34,14 +34,13 @@ namespace analysis
 	{
 		vec3 adir(0.f);
 		auto n = 0.f; // number of neighbors
-		sim.visit_all<prey_tag>([&](auto& p, size_t idx) {
+		const auto& pop = sim.pop<typename Agent::Tag>();
+		for (auto idx : sim.group_members<typename Agent::Tag>(sim.group_of<typename Agent::Tag>(idxf))) {
 			if (idx != idxf) {
-				if (sim.group_of<prey_tag>(idxf) == sim.group_of<prey_tag>(idx)) {
-					adir += math::ofs(pf.pos, p.pos);
-					++n;
-				}	
+				adir += math::ofs(pf.pos, pop[idx].pos);
+				++n;
 			}
-		});
+		}
 
 		if (n) {
 			return glm::length(adir / n);
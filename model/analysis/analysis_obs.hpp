@@ -5,29 +5,118 @@
 #include <model/observer.hpp>
 #include <agents/agents.hpp>
 #include <algorithm> 
+#include <numeric>
+#include <random>
+#include <limits>
+#include <iterator>
 
 
 namespace analysis
 {
+	// Selection of the agents written by TimeSeriesObserver, each with its own rate:
+	// "policies": [ { "type": "all" },
+	//               { "type": "subset", "size": 50, "seed": 1 },
+	//               { "type": "nearest_predator", "k": 20 },
+	//               { "type": "near_predator", "radius": 30 },
+	//               { "type": "state", "states": [2, 3] } ]
+	// Every policy takes an optional "sample_freq" [s], default: the observer's.
+	struct sampling_policy
+	{
+		enum class kind { all, subset, nearest_predator, near_predator, state };
+
+		kind type = kind::all;
+		tick_t freq = 0;						// [ticks]
+		tick_t next = 0;						// next sample tick
+		size_t size = 0;						// subset size, k nearest
+		uint64_t seed = 0;
+		float radius = 0.f;					// [m]
+		std::vector<unsigned> states;
+		std::vector<unsigned> subset;		// chosen at initialization
+
+		static sampling_policy parse(const json& J, tick_t default_freq)
+		{
+			static const std::pair<const char*, kind> kinds[] = {
+				{ "all", kind::all }, { "subset", kind::subset }, { "nearest_predator", kind::nearest_predator },
+				{ "near_predator", kind::near_predator }, { "state", kind::state },
+			};
+			sampling_policy sp;
+			const std::string type = J["type"];
+			const auto it = std::find_if(std::begin(kinds), std::end(kinds), [&](const auto& k) { return type == k.first; });
+			if (it == std::end(kinds)) throw std::runtime_error("TimeSeries: unknown sampling policy '" + type + "'");
+			sp.type = it->second;
+			const auto freq = optional_json<double>(J, "sample_freq");
+			sp.freq = sp.next = freq ? std::max(tick_t(1), model::Simulation::time2tick(*freq)) : default_freq;
+			switch (sp.type) {
+				case kind::subset:
+					sp.size = J["size"];
+					sp.seed = optional_json<uint64_t>(J, "seed").value_or(std::random_device{}());
+					break;
+				case kind::nearest_predator: sp.size = J["k"]; break;
+				case kind::near_predator: sp.radius = J["radius"]; break;
+				case kind::state: sp.states = J["states"].get<std::vector<unsigned>>(); break;
+				default: break;
+			}
+			return sp;
+		}
+	};
+
+
 	template <typename Tag>
 	class TimeSeriesObserver : public model::AnalysisObserver
 	{
 	public:
 		TimeSeriesObserver(const std::filesystem::path& out_path, const json& J) :
 			AnalysisObserver(out_path, J)
-		{}
+		{
+			if (J.contains("policies")) {
+				for (const auto& jp : J["policies"]) policies_.push_back(sampling_policy::parse(jp, oi_.sample_freq));
+				if (policies_.empty()) throw std::runtime_error("TimeSeries: empty 'policies'");
+				oi_.sample_tick = next_sample_tick(0);
+			}
+		}
 
 	protected:
+		void notify_init(const model::Simulation& sim) override
+		{
+			const size_t N = sim.pop<Tag>().size();
+			for (auto& sp : policies_) {
+				if (sp.type == sampling_policy::kind::subset) {
+					std::vector<unsigned> all(N);
+					std::iota(all.begin(), all.end(), 0u);
+					sp.subset.clear();
+					std::sample(all.cbegin(), all.cend(), std::back_inserter(sp.subset), sp.size, std::mt19937_64(sp.seed));
+				}
+			}
+		}
+
+		tick_t next_sample_tick(tick_t now) const override
+		{
+			if (policies_.empty()) return AnalysisObserver::next_sample_tick(now);
+			tick_t next = std::numeric_limits<tick_t>::max();
+			for (const auto& sp : policies_) next = std::min(next, sp.next);
+			return next;
+		}
+
+		// one row per selected agent in ascending order, rows are filled in parallel into the preallocated sample block
 		void notify_collect(const model::Simulation& sim) override
 		{
 			const auto tt = static_cast<float>(sim.tick()) * model::Simulation::dt();
+			const size_t cols = AnalysisObserver::columns();
+			const size_t first = data_out_.size();
+			const size_t rows = select(sim);
+			data_out_.resize(first + rows * cols);
 
-			sim.visit_all<Tag>([&](auto& p, size_t idx) {
-				const auto fl_id = sim.group_of<Tag>(idx);
-				const auto& thisgroup = sim.groups<Tag>()[fl_id];
-				const auto dist2cent = glm::distance(p.pos, thisgroup.gc()); // distance to center of group
-				//const auto dist2pred = p.dis	;
-				const auto dir2fcent = glm::normalize(math::ofs(p.pos, thisgroup.gc()));
+			sim.parallel_visit_all<Tag>([&](auto& p, size_t idx) {
+				const auto row_idx = policies_.empty() ? idx : row_of_[idx];
+				if (row_idx == no_row) return;
+				const auto fl_id = sim.group_of<Tag>(idx);    // -1 before the first detection
+				float dist2cent = 0.f;
+				glm::vec3 dir2fcent(0.f);
+				if (fl_id >= 0) {
+					const auto& thisgroup = sim.groups<Tag>()[fl_id];
+					dist2cent = glm::distance(p.pos, thisgroup.gc()); // distance to center of group
+					dir2fcent = glm::normalize(math::ofs(p.pos, thisgroup.gc()));
+				}
 				auto si = p.get_current_state();
 
 				const auto& all_nb = sim.sorted_view<Tag>(idx); // all neighbors
@@ -39,41 +128,100 @@ namespace analysis
 
 				if (all_nb.size()) {
 					nnd2 = all_nb.cbegin()->dist2;
-					float nnid = all_nb.cbegin()->idx;
-					
 					dir2nn = glm::normalize(math::ofs(p.pos, all_nb.cbegin()->pos));
-
-			  }
+				}
 				if (all_p.size()) {
 					d2p = all_p.cbegin()->dist2;
 				}
 
-				// copy into flat data store
-				const auto last = data_out_.size();
-				data_out_.resize(data_out_.size() + AnalysisObserver::columns());
-				auto* pf = data_out_.data() + last;
-				*pf = tt;
-				*(++pf) = static_cast<float>(idx),
-				*(++pf) = p.pos.x; *(++pf) = p.pos.y; *(++pf) = p.pos.z;
-				*(++pf) = p.dir.x; *(++pf) = p.dir.z; *(++pf) = p.dir.y;
-				*(++pf) = p.speed;
-				*(++pf) = p.accel.x; *(++pf) = p.accel.y; *(++pf) = p.accel.z;
-				*(++pf) = static_cast<float>(si.state()); *(++pf) = static_cast<float>(si.sub_state());
-				*(++pf) = dist2cent;
-				*(++pf) = dir2fcent.x; *(++pf) = dir2fcent.y; *(++pf) = dir2fcent.z;
-				*(++pf) = nnd2;
-				*(++pf) = dir2nn.x; *(++pf) = dir2nn.y; *(++pf) = dir2nn.z;
-
-				*(++pf) = fl_id;
-				*(++pf) = d2p;
-
+				const float row[] = {
+					tt, static_cast<float>(idx),
+					p.pos.x, p.pos.y, p.pos.z,
+					p.dir.x, p.dir.z, p.dir.y,
+					p.speed,
+					p.accel.x, p.accel.y, p.accel.z,
+					static_cast<float>(si.state()), static_cast<float>(si.sub_state()),
+					dist2cent,
+					dir2fcent.x, dir2fcent.y, dir2fcent.z,
+					nnd2,
+					dir2nn.x, dir2nn.y, dir2nn.z,
+					static_cast<float>(fl_id),
+					d2p
+				};
+				std::copy_n(row, std::min(cols, std::size(row)), data_out_.data() + first + row_idx * cols);
 			});
 		}
 
 		void notify_save(const model::Simulation& sim) override {
-			exporter_(data_out_.data(), data_out_.size());
-			data_out_.clear();
+			exporter_.submit(data_out_);
+		}
+
+	private:
+		static constexpr size_t no_row = size_t(-1);
+
+		// marks the agents of the due policies, returns the number of rows
+		size_t select(const model::Simulation& sim)
+		{
+			const size_t N = sim.pop<Tag>().size();
+			if (policies_.empty()) return N;
+			using kind = sampling_policy::kind;
+			const auto T = sim.tick();
+			row_of_.assign(N, no_row);
+			auto mark = [&](size_t idx) { row_of_[idx] = 0; };
+			for (auto& sp : policies_) {
+				if (T < sp.next) continue;
+				sp.next = T + sp.freq;
+				switch (sp.type) {
+					case kind::all:
+						std::fill(row_of_.begin(), row_of_.end(), 0);
+						break;
+					case kind::subset:
+						for (auto idx : sp.subset) mark(idx);
+						break;
+					case kind::nearest_predator: {
+						// k nearest of every predator from the per-tick spatial index
+						const size_t k = std::min(sp.size, N);
+						sim.nearest_neighbors<pred_tag, Tag>(sp.size, knn_);
+						for (size_t p = 0; p < sim.pop<pred_tag>().size(); ++p) {
+							for (size_t i = 0; i < k; ++i) mark(knn_[p * sp.size + i].idx);
+						}
+						break;
+					}
+					case kind::near_predator: {
+						// nearest predator distance of every agent, few predators
+						const auto& preds = sim.pop<pred_tag>();
+						const auto& pop = sim.pop<Tag>();
+						const float rr = sp.radius * sp.radius;
+						for (size_t idx = 0; idx < N; ++idx) {
+							for (const auto& pred : preds) {
+								if (glm::distance2(pop[idx].pos, pred.pos) <= rr) {
+									mark(idx);
+									break;
+								}
+							}
+						}
+						break;
+					}
+					case kind::state: {
+						const auto& pop = sim.pop<Tag>();
+						for (size_t idx = 0; idx < N; ++idx) {
+							const auto state = static_cast<unsigned>(pop[idx].get_current_state().state());
+							if (std::find(sp.states.cbegin(), sp.states.cend(), state) != sp.states.cend()) mark(idx);
+						}
+						break;
+					}
+				}
+			}
+			size_t rows = 0;
+			for (auto& r : row_of_) {
+				if (r != no_row) r = rows++;
+			}
+			return rows;
 		}
+
+		std::vector<sampling_policy> policies_;		// empty: all agents at sample_freq
+		std::vector<size_t> row_of_;							// agent -> row in the sample block
+		std::vector<model::neighbor_info> knn_;
 	};
 
 
@@ -90,49 +238,74 @@ namespace analysis
 		{
 			const auto tt = static_cast<float>(sim.tick()) * model::Simulation::dt();
 			const auto& fi = sim.groups<Tag>();
+			const auto& pop = sim.pop<Tag>();
 
-			const auto last = data_out_.size();
-			data_out_.resize(data_out_.size() + AnalysisObserver::columns() * fi.size());
-			auto* pf = data_out_.data() + last;
-			
 			size_t idx = 0;
 			for (auto& i : fi)
 			{
 				// polarization
 				auto pol = 0.f;
 				auto fdir = math::save_normalize(i.vel, vec3(0.f));
-				auto fm = sim.group_mates<Tag>(idx);
-				const auto& pop = sim.pop<Tag>();
+				const auto fm = sim.group_members<Tag>(idx);
 				for (const auto& midx : fm) {
 					pol += glm::dot(pop[midx].dir, fdir);
 			  };
 				pol /= static_cast<float>(i.size);
 				//pol /= fm.size();
-
-				*pf = tt;
-				*(++pf) = static_cast<float>(idx);
-				*(++pf) = static_cast<float>(i.size);
-				*(++pf) = i.vel.x; 
-				*(++pf) = i.vel.y; 
-				*(++pf) = i.vel.z;
-				*(++pf) = pol;
-				*(++pf) = i.ext.x * i.ext.y * i.ext.z;		// volume
-				*(++pf) = i.ext.x; 
-				*(++pf) = i.ext.y; 
-				*(++pf) = i.ext.z;
-				*(++pf) = i.H[0].x; *(++pf) = i.H[0].y; *(++pf) = i.H[0].z;
-				*(++pf) = i.H[1].x; *(++pf) = i.H[1].y; *(++pf) = i.H[1].z;
-				*(++pf) = i.H[2].x; *(++pf) = i.H[2].y; *(++pf) = i.H[2].z;
+				append_row(tt, idx, i, pol, sim.group_threshold());
 				++idx;
-				++pf;
+			}
+
+			// groups at the additional thresholds, requires the threshold column
+			if (AnalysisObserver::columns() > threshold_column) {
+				for (const auto& level : sim.group_levels<Tag>()) {
+					lpol_.assign(level.descr.size(), 0.f);
+					for (size_t m = 0; m < level.group_id.size(); ++m) {
+						const auto g = level.group_id[m];
+						if (g != model::no_group) {
+							lpol_[g] += glm::dot(pop[m].dir, math::save_normalize(level.descr[g].vel, vec3(0.f)));
+						}
+					}
+					for (size_t g = 0; g < level.descr.size(); ++g) {
+						append_row(tt, g, level.descr[g], lpol_[g] / static_cast<float>(level.descr[g].size), level.threshold);
+					}
+				}
 			}
 		}
 
 		void notify_save(const model::Simulation& sim) override
-		{ 
-			exporter_(data_out_.data(), data_out_.size());
-			data_out_.clear();
+		{
+			exporter_.submit(data_out_);
 		}
+
+	private:
+		static constexpr size_t label_column = 20;		// optional trailing columns
+		static constexpr size_t threshold_column = 21;
+
+		void append_row(float tt, size_t idx, const model::group_descr& i, float pol, float threshold)
+		{
+			const auto last = data_out_.size();
+			data_out_.resize(data_out_.size() + AnalysisObserver::columns());
+			auto* pf = data_out_.data() + last;
+			*pf = tt;
+			*(++pf) = static_cast<float>(idx);
+			*(++pf) = static_cast<float>(i.size);
+			*(++pf) = i.vel.x; 
+			*(++pf) = i.vel.y; 
+			*(++pf) = i.vel.z;
+			*(++pf) = pol;
+			*(++pf) = i.ext.x * i.ext.y * i.ext.z;		// volume
+			*(++pf) = i.ext.x; 
+			*(++pf) = i.ext.y; 
+			*(++pf) = i.ext.z;
+			*(++pf) = i.H[0].x; *(++pf) = i.H[0].y; *(++pf) = i.H[0].z;
+			*(++pf) = i.H[1].x; *(++pf) = i.H[1].y; *(++pf) = i.H[1].z;
+			*(++pf) = i.H[2].x; *(++pf) = i.H[2].y; *(++pf) = i.H[2].z;
+			if (AnalysisObserver::columns() > label_column) *(++pf) = static_cast<float>(i.label);
+			if (AnalysisObserver::columns() > threshold_column) *(++pf) = threshold;
+		}
+
+		std::vector<float> lpol_;
 	};
 
 }
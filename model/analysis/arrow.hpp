@@ -0,0 +1,300 @@
+#pragma once
+
+// Apache Arrow IPC file output (.arrow, aka Feather V2)
+//
+// file:    "ARROW1\0\0" | schema message | record batch message... | EOS | footer | footer size (int32) | "ARROW1"
+// message: 0xFFFFFFFF | metadata size (int32) | Message flatbuffer (padded to 8) | body
+//
+// All columns are non-nullable float32. Each submitted buffer becomes one
+// record batch, the body holds the columns back to back, 64 byte aligned.
+// The flatbuffer metadata is written by hand, see Schema.fbs, Message.fbs
+// and File.fbs of the Arrow format specification.
+
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include <initializer_list>
+#include <model/analysis/output_format.hpp>
+
+
+namespace analysis {
+  namespace arrow {
+
+    namespace detail {
+
+      constexpr int16_t metadata_v5 = 4;
+      constexpr uint8_t header_schema = 1;
+      constexpr uint8_t header_record_batch = 3;
+      constexpr uint8_t type_floating_point = 3;
+      constexpr int16_t precision_single = 1;
+      constexpr size_t body_alignment = 64;
+
+
+      // Minimal flatbuffer builder. Objects are appended in pre-order and
+      // references (uoffset_t, always pointing forward) are patched once
+      // their target is written.
+      class fb_builder
+      {
+      public:
+        // scalar or reference (size 4, patched later) table field
+        struct field
+        {
+          uint16_t id;
+          uint8_t size;
+          uint64_t value = 0;
+        };
+
+        struct table_ref
+        {
+          size_t at;                        // table position
+          std::array<size_t, 8> field;      // field positions by id
+        };
+
+        fb_builder() { root_ = slot(); }
+
+        size_t root() const noexcept { return root_; }
+        std::vector<uint8_t>& buffer() noexcept { return buf_; }
+
+        void align(size_t a, size_t rem = 0)
+        {
+          while (buf_.size() % a != rem) buf_.push_back(0);
+        }
+
+        template <typename T>
+        void put(const T& x)
+        {
+          const auto p = reinterpret_cast<const uint8_t*>(&x);
+          buf_.insert(buf_.end(), p, p + sizeof(T));
+        }
+
+        // makes the reference at 'at' point to 'target'
+        void patch(size_t at, size_t target)
+        {
+          const auto off = static_cast<uint32_t>(target - at);
+          std::memcpy(buf_.data() + at, &off, sizeof(off));
+        }
+
+        // vtable followed by the table, fields sorted by size for alignment
+        table_ref table(std::initializer_list<field> fields)
+        {
+          uint16_t n = 0;
+          for (const auto& f : fields) n = std::max<uint16_t>(n, f.id + 1);
+          std::array<uint16_t, 8> off{};
+          uint16_t inline_size = 4;       // soffset to vtable
+          for (uint8_t size : { 8, 4, 2, 1 }) {
+            for (const auto& f : fields) {
+              if (f.size == size) {
+                off[f.id] = inline_size;
+                inline_size += size;
+              }
+            }
+          }
+          align(2);
+          const auto vt = buf_.size();
+          put(static_cast<uint16_t>(4 + 2 * n));
+          put(inline_size);
+          for (uint16_t i = 0; i < n; ++i) put(off[i]);
+          align(8, 4);                    // 8 byte fields at 8 byte boundaries
+          table_ref ref{ buf_.size(), {} };
+          put(static_cast<int32_t>(ref.at - vt));
+          buf_.resize(ref.at + inline_size, 0);
+          for (const auto& f : fields) {
+            ref.field[f.id] = ref.at + off[f.id];
+            std::memcpy(buf_.data() + ref.field[f.id], &f.value, f.size);   // little endian
+          }
+          return ref;
+        }
+
+        // vector of n references, returns its position
+        size_t ref_vector(size_t n)
+        {
+          align(4);
+          const auto at = buf_.size();
+          put(static_cast<uint32_t>(n));
+          buf_.resize(buf_.size() + 4 * n, 0);
+          return at;
+        }
+
+        // vector of structs with 8 byte alignment
+        template <typename T>
+        size_t struct_vector(const std::vector<T>& v)
+        {
+          align(8, 4);
+          const auto at = buf_.size();
+          put(static_cast<uint32_t>(v.size()));
+          for (const auto& x : v) put(x);
+          return at;
+        }
+
+        size_t string(const std::string& str)
+        {
+          align(4);
+          const auto at = buf_.size();
+          put(static_cast<uint32_t>(str.size()));
+          buf_.insert(buf_.end(), str.cbegin(), str.cend());
+          buf_.push_back(0);
+          return at;
+        }
+
+      private:
+        size_t slot()
+        {
+          align(4);
+          const auto at = buf_.size();
+          put(uint32_t(0));
+          return at;
+        }
+
+        std::vector<uint8_t> buf_;
+        size_t root_;
+      };
+
+
+      struct field_node { int64_t length; int64_t null_count; };
+      struct buffer { int64_t offset; int64_t length; };
+      struct block { int64_t offset; int32_t metadata_length; int32_t pad; int64_t body_length; };
+
+
+      // Schema table of float32 columns, referenced from 'at'
+      inline void schema(fb_builder& b, size_t at, const std::vector<std::string>& names)
+      {
+        const auto s = b.table({ { 0, 2 }, { 1, 4 } });     // endianness (little), fields
+        b.patch(at, s.at);
+        const auto fields = b.ref_vector(names.size());
+        b.patch(s.field[1], fields);
+        for (size_t i = 0; i < names.size(); ++i) {
+          // name, nullable, type_type, type, children
+          const auto f = b.table({ { 0, 4 }, { 1, 1, 0 }, { 2, 1, type_floating_point }, { 3, 4 }, { 5, 4 } });
+          b.patch(fields + 4 + 4 * i, f.at);
+          b.patch(f.field[0], b.string(names[i]));
+          const auto fp = b.table({ { 0, 2, uint64_t(precision_single) } });
+          b.patch(f.field[3], fp.at);
+          b.patch(f.field[5], b.ref_vector(0));
+        }
+      }
+
+
+      // Message table, returns the position of the header reference
+      inline size_t message(fb_builder& b, uint8_t header_type, int64_t body_length)
+      {
+        const auto m = b.table({ { 0, 2, uint64_t(metadata_v5) }, { 1, 1, header_type }, { 2, 4 }, { 3, 8, uint64_t(body_length) } });
+        b.patch(b.root(), m.at);
+        return m.field[2];
+      }
+
+
+      // writes an encapsulated message, returns its metadata size
+      inline size_t write_message(std::ostream& os, std::vector<uint8_t>& fb)
+      {
+        while ((fb.size() + 8) % 8) fb.push_back(0);
+        const uint32_t cont = 0xFFFFFFFF;
+        const auto size = static_cast<int32_t>(fb.size());
+        os.write((const char*)&cont, sizeof(cont));
+        os.write((const char*)&size, sizeof(size));
+        os.write((const char*)fb.data(), fb.size());
+        return 8 + fb.size();
+      }
+
+    }
+
+
+    // writer, runs on the exporter's writer thread
+    class writer : public output_format
+    {
+    public:
+      writer(const std::filesystem::path& path, const std::string& header, size_t columns) :
+        path_(path), names_(split_header(header))
+      {
+        if (names_.size() != columns) throw std::runtime_error("arrow: header doesn't match column count");
+        os_.open(path_, std::ios::binary);
+        if (!os_) throw std::runtime_error("can't open " + path_.string());
+        os_.write(magic, 8);
+        detail::fb_builder b;
+        detail::schema(b, detail::message(b, detail::header_schema, 0), names_);
+        offset_ = 8 + detail::write_message(os_, b.buffer());
+      }
+
+      size_t write(const float* first, size_t n) override
+      {
+        const size_t columns = names_.size();
+        const size_t rows = n / columns;
+        if (rows == 0) return 0;
+        const size_t col_bytes = rows * sizeof(float);
+        const size_t col_stride = (col_bytes + detail::body_alignment - 1) / detail::body_alignment * detail::body_alignment;
+        const auto body_length = static_cast<int64_t>(columns * col_stride);
+
+        // record batch metadata: one node and (validity, data) buffers per column
+        std::vector<detail::field_node> nodes(columns, { int64_t(rows), 0 });
+        std::vector<detail::buffer> buffers;
+        for (size_t c = 0; c < columns; ++c) {
+          buffers.push_back({ int64_t(c * col_stride), 0 });
+          buffers.push_back({ int64_t(c * col_stride), int64_t(col_bytes) });
+        }
+        detail::fb_builder b;
+        const auto header = detail::message(b, detail::header_record_batch, body_length);
+        const auto rb = b.table({ { 0, 8, rows }, { 1, 4 }, { 2, 4 } });     // length, nodes, buffers
+        b.patch(header, rb.at);
+        b.patch(rb.field[1], b.struct_vector(nodes));
+        b.patch(rb.field[2], b.struct_vector(buffers));
+        const auto meta = detail::write_message(os_, b.buffer());
+
+        // body: row-major -> column-major
+        body_.assign(body_length / sizeof(float), 0.f);
+        for (size_t r = 0; r < rows; ++r) {
+          const float* row = first + r * columns;
+          for (size_t c = 0; c < columns; ++c) {
+            body_[c * (col_stride / sizeof(float)) + r] = row[c];
+          }
+        }
+        os_.write((const char*)body_.data(), body_length);
+        if (!os_) throw std::runtime_error("can't write " + path_.string());
+        blocks_.push_back({ int64_t(offset_), int32_t(meta), 0, body_length });
+        offset_ += meta + body_length;
+        return meta + body_length;
+      }
+
+      void flush() override { os_.flush(); }
+
+      void close() override
+      {
+        if (!os_.is_open()) return;
+        const uint32_t eos[2] = { 0xFFFFFFFF, 0 };
+        os_.write((const char*)eos, sizeof(eos));
+        detail::fb_builder b;
+        // version, schema, dictionaries, recordBatches
+        const auto ft = b.table({ { 0, 2, uint64_t(detail::metadata_v5) }, { 1, 4 }, { 2, 4 }, { 3, 4 } });
+        b.patch(b.root(), ft.at);
+        detail::schema(b, ft.field[1], names_);
+        b.patch(ft.field[2], b.struct_vector(std::vector<detail::block>{}));
+        b.patch(ft.field[3], b.struct_vector(blocks_));
+        auto& fb = b.buffer();
+        while (fb.size() % 8) fb.push_back(0);
+        const auto size = static_cast<int32_t>(fb.size());
+        os_.write((const char*)fb.data(), fb.size());
+        os_.write((const char*)&size, sizeof(size));
+        os_.write(magic, 6);
+        os_.close();
+        if (!os_) throw std::runtime_error("can't write " + path_.string());
+      }
+
+      const std::filesystem::path& path() const noexcept override { return path_; }
+
+    private:
+      static constexpr const char magic[8] = { 'A', 'R', 'R', 'O', 'W', '1', 0, 0 };
+
+      std::ofstream os_;
+      std::filesystem::path path_;
+      std::vector<std::string> names_;
+      std::vector<float> body_;
+      std::vector<detail::block> blocks_;
+      size_t offset_ = 0;
+    };
+
+  }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+// parallel conversion of binary observer output (rows of floats) to csv
+
+#include <charconv>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include <tbb/parallel_pipeline.h>
+#include <tbb/task_arena.h>
+#include <model/analysis/bin_file.hpp>
+
+
+namespace analysis {
+
+
+  struct bin2csv_options
+  {
+    int precision = 6;              // significant digits [1, 9], 0: shortest round-trip
+    size_t chunk_rows = 4096;       // rows formatted per task
+  };
+
+
+  namespace detail {
+
+    inline char* format_float(char* first, char* last, float val, int precision)
+    {
+      const auto res = (precision > 0)
+        ? std::to_chars(first, last, val, std::chars_format::general, precision)
+        : std::to_chars(first, last, val);
+      return res.ptr;
+    }
+
+  }
+
+
+  // Formats the rows of [first, first + rows * columns) into os.
+  // Chunks of rows are formatted in parallel, output order is preserved.
+  inline void format_csv(std::ostream& os, const float* first, size_t rows, size_t columns, const bin2csv_options& opt = {})
+  {
+    if (rows == 0 || columns == 0) return;
+    const size_t chunk_rows = std::max(size_t(1), opt.chunk_rows);
+    const size_t chunks = (rows + chunk_rows - 1) / chunk_rows;
+    const size_t max_chars = 32;   // per value, separator included
+    const int precision = std::clamp(opt.precision, 0, 9);
+    size_t next = 0;
+    tbb::parallel_pipeline(2 * tbb::this_task_arena::max_concurrency(),
+      tbb::make_filter<void, size_t>(tbb::filter_mode::serial_in_order, [&](tbb::flow_control& fc) -> size_t {
+        if (next == chunks) {
+          fc.stop();
+          return 0;
+        }
+        return next++;
+      }) &
+      tbb::make_filter<size_t, std::string>(tbb::filter_mode::parallel, [&](size_t chunk) {
+        const size_t r0 = chunk * chunk_rows;
+        const size_t r1 = std::min(rows, r0 + chunk_rows);
+        std::string buf((r1 - r0) * columns * max_chars, '\0');
+        char* p = buf.data();
+        char* const last = buf.data() + buf.size();
+        for (size_t r = r0; r < r1; ++r) {
+          const float* row = first + r * columns;
+          p = detail::format_float(p, last, row[0], precision);
+          for (size_t c = 1; c < columns; ++c) {
+            *p++ = ',';
+            p = detail::format_float(p, last, row[c], precision);
+          }
+          *p++ = '\n';
+        }
+        buf.resize(p - buf.data());
+        return buf;
+      }) &
+      tbb::make_filter<std::string, void>(tbb::filter_mode::serial_in_order, [&](const std::string& buf) {
+        os.write(buf.data(), buf.size());
+      })
+    );
+  }
+
+
+  // Appends the complete rows of the binary file bin_path to csv_path.
+  // columns is only needed for headerless files without .csv sidecar.
+  // A trailing incomplete row is ignored.
+  // Returns the number of rows written.
+  inline size_t bin2csv(const std::filesystem::path& bin_path, const std::filesystem::path& csv_path, size_t columns = 0, const bin2csv_options& opt = {})
+  {
+    const auto bin = bin::reader(bin_path, columns);
+    auto os = std::ofstream(csv_path, std::ios::binary | std::ios::app);
+    if (!os) throw std::runtime_error("can't open " + csv_path.string());
+    format_csv(os, bin.data(), bin.rows(), bin.columns(), opt);
+    if (!os) throw std::runtime_error("can't write " + csv_path.string());
+    return bin.rows();
+  }
+
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+// Self-describing binary observer output (.bin)
+//
+// file:  file_header | header string | padding | rows (float32, row-major) | index_entry[index_size]
+//
+// 'rows' and the time index are filled in when the file is closed; for
+// interrupted runs the row count follows from the file size and time
+// lookups fall back to bisection. Files without file_header (older runs)
+// are plain rows, their layout comes from the .csv sidecar.
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include <libs/mapped_file.hpp>
+
+
+namespace analysis {
+  namespace bin {
+
+
+    enum class dtype : uint32_t
+    {
+      float32 = 0,
+    };
+
+
+    struct file_header
+    {
+      char magic[8] = { 'D', 'N', 'C', 'S', 'B', 'I', 'N', '\0' };
+      uint32_t version = 1;
+      dtype type = dtype::float32;
+      uint64_t columns = 0;
+      uint64_t rows = 0;              // 0 until closed
+      double sample_freq = 0.0;       // [s], 0: unknown
+      uint64_t header_size = 0;       // [bytes] of the header string following
+      uint64_t data_offset = 0;       // [bytes] first row, 64 byte aligned
+      uint64_t index_offset = 0;      // [bytes] time index, 0: none
+      uint64_t index_size = 0;        // index entries
+    };
+
+
+    // first row of each distinct value of the first column (time)
+    struct index_entry
+    {
+      double time = 0.0;
+      uint64_t row = 0;
+    };
+
+
+    constexpr size_t data_alignment = 64;
+
+
+    // returns the column index of 'name' in the comma separated 'header'
+    inline size_t column_index(const std::string& header, const std::string& name)
+    {
+      size_t col = 0;
+      size_t first = 0;
+      for (;;) {
+        const auto last = header.find(',', first);
+        auto h = header.substr(first, last - first);
+        h.erase(0, h.find_first_not_of(" \t\r"));
+        h.erase(h.find_last_not_of(" \t\r") + 1);
+        if (h == name) return col;
+        if (last == std::string::npos) break;
+        first = last + 1;
+        ++col;
+      }
+      throw std::runtime_error("unknown column '" + name + "'");
+    }
+
+
+    // memory mapped reader for .bin files with or without file_header
+    class reader
+    {
+    public:
+      // columns: column count of headerless files, 0: from the .csv sidecar
+      explicit reader(const std::filesystem::path& path, size_t columns = 0) : path_(path)
+      {
+        if (std::filesystem::file_size(path_) > 0) file_.open(path_);
+        const auto* first = file_.data();
+        if (file_.size() >= sizeof(file_header) && 0 == std::memcmp(first, file_header{}.magic, sizeof(file_header{}.magic))) {
+          std::memcpy(&fh_, first, sizeof(fh_));
+          if (fh_.version != file_header{}.version) throw std::runtime_error("bin: version mismatch " + path_.string());
+          if (fh_.type != dtype::float32) throw std::runtime_error("bin: unsupported dtype " + path_.string());
+          if (fh_.columns == 0 || fh_.data_offset > file_.size()) throw std::runtime_error("bin: corrupted header " + path_.string());
+          header_.assign(first + sizeof(fh_), fh_.header_size);
+          const size_t data_end = fh_.index_offset ? fh_.index_offset : file_.size();
+          const size_t avail = (data_end - fh_.data_offset) / (fh_.columns * sizeof(float));
+          rows_ = fh_.rows ? std::min<size_t>(fh_.rows, avail) : avail;
+          if (fh_.index_offset && fh_.index_offset + fh_.index_size * sizeof(index_entry) <= file_.size()) {
+            index_.resize(fh_.index_size);
+            std::memcpy(index_.data(), first + fh_.index_offset, fh_.index_size * sizeof(index_entry));
+          }
+        }
+        else {
+          // headerless: layout from the sidecar
+          auto is = std::ifstream(std::filesystem::path(path_).replace_extension(".csv"));
+          if (is) std::getline(is, header_);
+          if (columns == 0) {
+            if (header_.empty()) throw std::runtime_error("no column count given and no csv header for " + path_.string());
+            columns = std::count(header_.cbegin(), header_.cend(), ',') + 1;
+          }
+          fh_.columns = columns;
+          rows_ = file_.size() / (columns * sizeof(float));
+        }
+      }
+
+      bool self_describing() const noexcept { return fh_.data_offset != 0; }
+      size_t columns() const noexcept { return fh_.columns; }
+      size_t rows() const noexcept { return rows_; }
+      double sample_freq() const noexcept { return fh_.sample_freq; }
+      const std::string& header() const noexcept { return header_; }
+      const std::vector<index_entry>& index() const noexcept { return index_; }
+      const std::filesystem::path& path() const noexcept { return path_; }
+
+      const float* data() const noexcept { return reinterpret_cast<const float*>(file_.data() + fh_.data_offset); }
+      const float* row(size_t r) const noexcept { return data() + r * fh_.columns; }
+      float time(size_t r) const noexcept { return row(r)[0]; }
+
+      size_t column(const std::string& name) const { return column_index(header_, name); }
+
+      // rows [first, last) with t0 <= time <= t1
+      std::pair<size_t, size_t> time_range(double t0, double t1) const
+      {
+        return { lower_bound(t0), upper_bound(t1) };
+      }
+
+      // rows [first, last) of the sample closest to t
+      std::pair<size_t, size_t> sample(double t) const
+      {
+        if (rows_ == 0) return { 0, 0 };
+        size_t lo = lower_bound(t);
+        if ((lo == rows_) || ((lo > 0) && (t - time(lo - 1) < time(lo) - t))) --lo;
+        const float ts = time(lo);
+        return time_range(ts, ts);
+      }
+
+    private:
+      // first row with time >= t
+      size_t lower_bound(double t) const
+      {
+        if (!index_.empty()) {
+          const auto it = std::lower_bound(index_.cbegin(), index_.cend(), t, [](const index_entry& e, double t) { return e.time < t; });
+          return (it == index_.cend()) ? rows_ : static_cast<size_t>(it->row);
+        }
+        size_t lo = 0, hi = rows_;
+        while (lo < hi) {
+          const size_t mid = lo + (hi - lo) / 2;
+          if (time(mid) < t) lo = mid + 1; else hi = mid;
+        }
+        return lo;
+      }
+
+      // first row with time > t
+      size_t upper_bound(double t) const
+      {
+        if (!index_.empty()) {
+          const auto it = std::upper_bound(index_.cbegin(), index_.cend(), t, [](double t, const index_entry& e) { return t < e.time; });
+          return (it == index_.cend()) ? rows_ : static_cast<size_t>(it->row);
+        }
+        size_t lo = 0, hi = rows_;
+        while (lo < hi) {
+          const size_t mid = lo + (hi - lo) / 2;
+          if (!(t < time(mid))) lo = mid + 1; else hi = mid;
+        }
+        return lo;
+      }
+
+      std::filesystem::path path_;
+      mapped_file::reader file_;
+      file_header fh_;
+      size_t rows_ = 0;
+      std::string header_;
+      std::vector<index_entry> index_;
+    };
+
+  }
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+// column/time/predicate slices of .bin observer output
+//
+// The time range is located through the file's time index (or by
+// bisection), the remaining rows are filtered in parallel blocks.
+// Results are delivered in file order.
+
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <limits>
+#include <charconv>
+#include <stdexcept>
+#include <tbb/parallel_pipeline.h>
+#include <tbb/task_arena.h>
+#include <model/analysis/bin_file.hpp>
+
+
+namespace analysis {
+  namespace bin {
+
+
+    // column <op> value
+    struct predicate
+    {
+      enum class op { eq, ne, lt, le, gt, ge };
+
+      size_t column;
+      op cmp;
+      float value;
+
+      bool operator()(const float* row) const noexcept
+      {
+        const float x = row[column];
+        switch (cmp) {
+          case op::eq: return x == value;
+          case op::ne: return x != value;
+          case op::lt: return x < value;
+          case op::le: return x <= value;
+          case op::gt: return x > value;
+          case op::ge: return x >= value;
+        }
+        return false;
+      }
+    };
+
+
+    // parses "<column><op><value>", op one of == != < <= > >=
+    inline predicate parse_predicate(const reader& bin, const std::string& expr)
+    {
+      static const std::pair<const char*, predicate::op> ops[] = {
+        { "==", predicate::op::eq }, { "!=", predicate::op::ne },
+        { "<=", predicate::op::le }, { ">=", predicate::op::ge },
+        { "<", predicate::op::lt }, { ">", predicate::op::gt },
+      };
+      for (const auto& [token, cmp] : ops) {
+        const auto pos = expr.find(token);
+        if (pos == std::string::npos) continue;
+        const auto val = expr.substr(pos + std::strlen(token));
+        float value = 0;
+        const auto res = std::from_chars(val.data(), val.data() + val.size(), value);
+        if (res.ec != std::errc{} || res.ptr != val.data() + val.size()) throw std::runtime_error("invalid value in '" + expr + "'");
+        return { bin.column(expr.substr(0, pos)), cmp, value };
+      }
+      throw std::runtime_error("invalid predicate '" + expr + "'");
+    }
+
+
+    struct selection
+    {
+      std::vector<size_t> columns;          // output columns, empty: all
+      double t0 = -std::numeric_limits<double>::infinity();
+      double t1 = std::numeric_limits<double>::infinity();
+      std::vector<predicate> where;         // all must hold
+      size_t block_rows = 65536;            // rows scanned per task
+    };
+
+
+    // Calls sink(const float* rows, size_t n) in file order with the
+    // selected columns of the matching rows, row-major.
+    // Returns the number of matching rows.
+    template <typename Sink>
+    inline size_t scan(const reader& bin, const selection& sel, Sink&& sink)
+    {
+      std::vector<size_t> cols = sel.columns;
+      if (cols.empty()) {
+        for (size_t c = 0; c < bin.columns(); ++c) cols.push_back(c);
+      }
+      for (auto c : cols) {
+        if (c >= bin.columns()) throw std::runtime_error("bin query: column out of range");
+      }
+      const auto range = bin.time_range(sel.t0, sel.t1);
+      const size_t last = range.second;
+      const size_t block_rows = std::max(size_t(1), sel.block_rows);
+      size_t next = range.first;
+      size_t matches = 0;
+      tbb::parallel_pipeline(2 * tbb::this_task_arena::max_concurrency(),
+        tbb::make_filter<void, std::pair<size_t, size_t>>(tbb::filter_mode::serial_in_order, [&](tbb::flow_control& fc) {
+          if (next >= last) {
+            fc.stop();
+            return std::pair<size_t, size_t>{};
+          }
+          const auto r0 = next;
+          next = std::min(last, next + block_rows);
+          return std::pair<size_t, size_t>{ r0, next };
+        }) &
+        tbb::make_filter<std::pair<size_t, size_t>, std::vector<float>>(tbb::filter_mode::parallel, [&](std::pair<size_t, size_t> block) {
+          std::vector<float> out;
+          for (size_t r = block.first; r < block.second; ++r) {
+            const float* row = bin.row(r);
+            bool match = true;
+            for (const auto& pred : sel.where) match = match && pred(row);
+            if (match) {
+              for (auto c : cols) out.push_back(row[c]);
+            }
+          }
+          return out;
+        }) &
+        tbb::make_filter<std::vector<float>, void>(tbb::filter_mode::serial_in_order, [&](const std::vector<float>& out) {
+          if (!out.empty()) {
+            matches += out.size() / cols.size();
+            sink(out.data(), out.size() / cols.size());
+          }
+        })
+      );
+      return matches;
+    }
+
+
+    // selected columns of the matching rows, row-major
+    inline std::vector<float> select(const reader& bin, const selection& sel)
+    {
+      std::vector<float> res;
+      scan(bin, sel, [&](const float* rows, size_t n) {
+        res.insert(res.end(), rows, rows + n * (sel.columns.empty() ? bin.columns() : sel.columns.size()));
+      });
+      return res;
+    }
+
+  }
+}
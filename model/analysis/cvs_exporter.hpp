@@ -1,19 +1,27 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <deque>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 #include <regex>
+#include <iostream>
+#include <memory>
 #include <model/json.hpp>
+#include <model/analysis/output_format.hpp>
+#include <model/analysis/dcol.hpp>
+#include <model/analysis/arrow.hpp>
 
 
 namespace analysis {
 
 
-  inline void append_bin2csv(std::filesystem::path path, size_t columns);
-
-  
   inline std::string parse_header(const std::string& h) {
     if (h.empty()) return h;
     std::vector<std::string> cols;
@@ -39,56 +47,170 @@ namespace analysis {
   }
 
 
+  // back-pressure metrics of the background writer
+  struct write_stats
+  {
+    size_t buffers = 0;       // submitted buffers
+    size_t bytes = 0;         // bytes written
+    size_t stalls = 0;        // submissions that waited for the writer
+    double stall_ms = 0.0;    // [ms] accumulated waiting time
+    size_t max_queued = 0;    // deepest write queue observed
+  };
+
+
+  // creates the output format selected by the optional "format" entry
+  inline std::unique_ptr<output_format> make_output_format(const std::filesystem::path& out_path, const json& J, const std::string& header, size_t columns)
+  {
+    const std::string out_name = J["output_name"];
+    const auto format = optional_json<std::string>(J, "format").value_or("bin");
+    if (format == "bin") return std::make_unique<raw_format>(out_path / (out_name + ".bin"), header, columns, optional_json<double>(J, "sample_freq").value_or(0.0), J["skip_csv"]);
+    if (format == "dcol") {
+      // optional "quantize": { "<column>": step, ... }
+      std::vector<float> step(columns, 0.f);
+      if (J.contains("quantize")) {
+        const auto names = split_header(header);
+        for (const auto& [key, val] : J["quantize"].items()) {
+          const auto it = std::find(names.cbegin(), names.cend(), key);
+          if (it == names.cend()) throw std::runtime_error("unknown column '" + key + "' in quantize");
+          step[std::distance(names.cbegin(), it)] = val.get<float>();
+        }
+      }
+      return std::make_unique<dcol::writer>(out_path / (out_name + ".dcol"), header, columns, std::move(step));
+    }
+    if (format == "arrow") return std::make_unique<arrow::writer>(out_path / (out_name + ".arrow"), header, columns);
+    throw std::runtime_error("unknown output format '" + format + "'");
+  }
+
+
+  // Output is written by a dedicated thread. Submitted buffers are
+  // swapped against recycled ones; at most 'write_queue' buffers are in
+  // flight before submissions block.
   class cvs_exporter {
   public:
     cvs_exporter(const std::filesystem::path& out_path, const json& J) {
-      skip_csv_ = J["skip_csv"];
-      const std::string out_name = J["output_name"];
       header_ = parse_header(J["header"]);
       columns_ = std::count(header_.cbegin(), header_.cend(), ',') + 1;
-      bin_path_ = out_path / (out_name + ".bin");
-      os_.open(bin_path_, std::ios::binary);
-      auto os = std::ofstream(std::filesystem::path(bin_path_).replace_extension(".csv"));
-      os << header_ << '\n';
+      max_queued_ = std::max(size_t(1), optional_json<size_t>(J, "write_queue").value_or(2));
+      format_ = make_output_format(out_path, J, header_, columns_);
+      writer_ = std::thread(&cvs_exporter::write_loop, this);
     }
 
     ~cvs_exporter() {
-      if (os_ && !skip_csv_) {
-        os_.close();
-        append_bin2csv(bin_path_, columns_);
+      {
+        std::lock_guard<std::mutex> _(mutex_);
+        stop_ = true;
+      }
+      cv_.notify_all();
+      writer_.join();
+      try {
+        format_->close();
+      }
+      catch (const std::exception& err) {
+        std::cerr << err.what() << std::endl;
       }
     }
 
+    // queues a copy of [first, first + n)
     void operator()(const float* first, size_t n) {
-      os_.write((const char*)(first), sizeof(float) * n);
+      std::unique_lock<std::mutex> lock(mutex_);
+      auto buf = acquire(lock);
+      buf.assign(first, first + n);
+      enqueue(std::move(buf));
+    }
+
+    // queues the content of data, data is replaced by an empty recycled buffer
+    void submit(std::vector<float>& data) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      auto buf = acquire(lock);
+      buf.swap(data);
+      enqueue(std::move(buf));
+    }
+
+    // blocks until all submitted data is written
+    void flush() {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [&]() { return (queue_.empty() && !writing_) || error_; });
+      if (error_) std::rethrow_exception(error_);
+      format_->flush();
+    }
+
+    write_stats stats() const {
+      std::lock_guard<std::mutex> _(mutex_);
+      return stats_;
     }
 
     size_t columns() const noexcept { return columns_; }
     const std::string& header() const noexcept { return header_; }
-    std::filesystem::path out_path() { return bin_path_.parent_path(); }
+    std::filesystem::path out_path() { return format_->path().parent_path(); }
+    const std::filesystem::path& path() const noexcept { return format_->path(); }
 
   private:
-    std::ofstream os_;   // binary
-    std::filesystem::path bin_path_;
-    bool skip_csv_;
-    size_t columns_;
-    std::string header_;
-  };
+    std::vector<float> acquire(std::unique_lock<std::mutex>& lock) {
+      if (error_) std::rethrow_exception(error_);
+      if (queue_.size() + writing_ >= max_queued_) {
+        const auto t0 = std::chrono::steady_clock::now();
+        cv_.wait(lock, [&]() { return queue_.size() + writing_ < max_queued_ || error_; });
+        ++stats_.stalls;
+        stats_.stall_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        if (error_) std::rethrow_exception(error_);
+      }
+      std::vector<float> buf;
+      if (!free_.empty()) {
+        buf.swap(free_.back());
+        free_.pop_back();
+      }
+      return buf;
+    }
 
+    void enqueue(std::vector<float>&& buf) {
+      queue_.emplace_back(std::move(buf));
+      ++stats_.buffers;
+      stats_.max_queued = std::max(stats_.max_queued, queue_.size());
+      cv_.notify_all();
+    }
 
-  inline void append_bin2csv(std::filesystem::path path, size_t columns) {
-    auto is = std::ifstream(path, std::ios::binary);
-    auto os = std::ofstream(std::filesystem::path(path).replace_extension(".csv"), std::ios::app);
-    std::vector<float> row_data(columns);
-    while (is) {
-      // borderline UD
-      is.read((char*)row_data.data(), sizeof(float) * columns);
-      os << row_data[0];
-      for (size_t c = 1; c < columns; ++c) {
-        os << ',' << row_data[c];
+    void write_loop() {
+      std::unique_lock<std::mutex> lock(mutex_);
+      for (;;) {
+        cv_.wait(lock, [&]() { return !queue_.empty() || stop_; });
+        if (queue_.empty()) break;    // stop_ and drained
+        auto buf = std::move(queue_.front());
+        queue_.pop_front();
+        writing_ = true;
+        lock.unlock();
+        size_t bytes = 0;
+        std::exception_ptr error;
+        try {
+          bytes = format_->write(buf.data(), buf.size());
+        }
+        catch (...) {
+          error = std::current_exception();
+        }
+        lock.lock();
+        writing_ = false;
+        if (error && !error_) error_ = error;
+        stats_.bytes += bytes;
+        buf.clear();
+        free_.emplace_back(std::move(buf));
+        cv_.notify_all();
       }
-      os << '\n';
     }
-  }
+
+    std::unique_ptr<output_format> format_;
+    size_t columns_;
+    std::string header_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::vector<float>> queue_;    // pending writes
+    std::vector<std::vector<float>> free_;    // recycled buffers
+    size_t max_queued_ = 2;
+    bool writing_ = false;
+    bool stop_ = false;
+    std::exception_ptr error_;
+    write_stats stats_;
+    std::thread writer_;
+  };
+
 
 }
@@ -0,0 +1,485 @@
+#pragma once
+
+// Compressed column-major observer output (.dcol)
+//
+// file:   file_header | header string | chunk... | chunk_entry[chunks] | footer
+// chunk:  chunk_header | column block[columns]
+// column: encoding (uint8) | step (float, quantized only) | payload size (uint64) | payload
+//
+// Each chunk holds the rows of one submitted buffer and decodes on its own.
+// Values are predicted by the value of the same column 'stride' rows before,
+// stride being the number of rows per sample if constant within the chunk
+// (the previous sample of the same agent in TimeSeries output), 1 otherwise.
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <bit>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include <libs/mapped_file.hpp>
+#include <model/analysis/output_format.hpp>
+
+
+namespace analysis {
+  namespace dcol {
+
+
+    enum class encoding : uint8_t
+    {
+      raw = 0,
+      xor_float = 1,    // Gorilla-style XOR against the prediction
+      int_delta = 2,    // zigzag varint delta, integral columns (ids, states)
+      quantized = 3,    // zigzag varint delta of round(value / step), lossy
+    };
+
+
+    struct file_header
+    {
+      char magic[8] = { 'D', 'N', 'C', 'S', 'D', 'C', 'O', 'L' };
+      uint32_t version = 1;
+      uint32_t columns = 0;
+      uint64_t header_size = 0;     // [bytes] of the header string following
+    };
+
+
+    struct chunk_header
+    {
+      uint32_t rows = 0;
+      uint32_t stride = 1;
+    };
+
+
+    struct chunk_entry
+    {
+      uint64_t offset = 0;          // [bytes] from the start of the file
+      uint64_t size = 0;            // [bytes]
+      uint64_t first_row = 0;
+      uint32_t rows = 0;
+      float t_first = 0.f;          // first column of the first and last row
+      float t_last = 0.f;
+    };
+
+
+    struct footer
+    {
+      uint64_t index_offset = 0;
+      uint64_t chunks = 0;
+      char magic[8] = { 'D', 'N', 'C', 'S', 'D', 'C', 'O', 'L' };
+    };
+
+
+    namespace detail {
+
+      inline uint32_t to_bits(float x) noexcept { return std::bit_cast<uint32_t>(x); }
+      inline float from_bits(uint32_t x) noexcept { return std::bit_cast<float>(x); }
+      inline uint64_t zigzag(int64_t x) noexcept { return (static_cast<uint64_t>(x) << 1) ^ static_cast<uint64_t>(x >> 63); }
+      inline int64_t unzigzag(uint64_t x) noexcept { return static_cast<int64_t>(x >> 1) ^ -static_cast<int64_t>(x & 1); }
+
+      inline void put_varint(std::vector<uint8_t>& out, uint64_t x)
+      {
+        while (x >= 0x80) {
+          out.push_back(static_cast<uint8_t>(x) | 0x80);
+          x >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(x));
+      }
+
+      inline uint64_t get_varint(const uint8_t*& p, const uint8_t* end)
+      {
+        uint64_t x = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+          if (p == end) throw std::runtime_error("dcol: truncated varint");
+          const uint8_t b = *p++;
+          x |= static_cast<uint64_t>(b & 0x7f) << shift;
+          if (!(b & 0x80)) return x;
+        }
+        throw std::runtime_error("dcol: corrupted varint");
+      }
+
+      template <typename T>
+      inline void put_pod(std::vector<uint8_t>& out, const T& x)
+      {
+        const auto p = reinterpret_cast<const uint8_t*>(&x);
+        out.insert(out.end(), p, p + sizeof(T));
+      }
+
+      template <typename T>
+      inline T get_pod(const uint8_t*& p, const uint8_t* end)
+      {
+        if (static_cast<size_t>(end - p) < sizeof(T)) throw std::runtime_error("dcol: truncated chunk");
+        T x;
+        std::memcpy(&x, p, sizeof(T));
+        p += sizeof(T);
+        return x;
+      }
+
+
+      class bit_writer
+      {
+      public:
+        explicit bit_writer(std::vector<uint8_t>& out) : out_(out) {}
+
+        void put(uint32_t bits, int count)
+        {
+          acc_ = (acc_ << count) | (count < 32 ? (bits & ((1u << count) - 1)) : bits);
+          n_ += count;
+          while (n_ >= 8) {
+            n_ -= 8;
+            out_.push_back(static_cast<uint8_t>(acc_ >> n_));
+          }
+        }
+
+        void finish()
+        {
+          if (n_) out_.push_back(static_cast<uint8_t>(acc_ << (8 - n_)));
+          n_ = 0;
+        }
+
+      private:
+        std::vector<uint8_t>& out_;
+        uint64_t acc_ = 0;
+        int n_ = 0;
+      };
+
+
+      class bit_reader
+      {
+      public:
+        bit_reader(const uint8_t* first, const uint8_t* last) : p_(first), end_(last) {}
+
+        uint32_t get(int count)
+        {
+          while (n_ < count) {
+            if (p_ == end_) throw std::runtime_error("dcol: truncated bit stream");
+            acc_ = (acc_ << 8) | *p_++;
+            n_ += 8;
+          }
+          n_ -= count;
+          return static_cast<uint32_t>((acc_ >> n_) & ((uint64_t(1) << count) - 1));
+        }
+
+      private:
+        const uint8_t* p_;
+        const uint8_t* end_;
+        uint64_t acc_ = 0;
+        int n_ = 0;
+      };
+
+
+      // Gorilla XOR stream: '0' same as prediction, '10' meaningful bits
+      // within the previous window, '11' 5 bits leading zeros, 5 bits
+      // (length - 1), meaningful bits.
+      inline void encode_xor(const float* col, size_t rows, size_t columns, size_t stride, std::vector<uint8_t>& out)
+      {
+        bit_writer bw(out);
+        int plz = -1, ptz = 0;
+        for (size_t r = 0; r < rows; ++r) {
+          const uint32_t pred = (r >= stride) ? to_bits(col[(r - stride) * columns]) : 0u;
+          const uint32_t x = to_bits(col[r * columns]) ^ pred;
+          if (x == 0) {
+            bw.put(0, 1);
+            continue;
+          }
+          const int lz = std::min(31, std::countl_zero(x));
+          const int tz = std::countr_zero(x);
+          if (plz >= 0 && lz >= plz && tz >= ptz) {
+            bw.put(2, 2);
+            bw.put(x >> ptz, 32 - plz - ptz);
+          }
+          else {
+            const int len = 32 - lz - tz;
+            bw.put(3, 2);
+            bw.put(static_cast<uint32_t>(lz), 5);
+            bw.put(static_cast<uint32_t>(len - 1), 5);
+            bw.put(x >> tz, len);
+            plz = lz;
+            ptz = tz;
+          }
+        }
+        bw.finish();
+      }
+
+
+      inline void decode_xor(const uint8_t* first, const uint8_t* last, size_t rows, size_t stride, float* dst, size_t dst_stride)
+      {
+        bit_reader br(first, last);
+        int plz = 0, ptz = 0;
+        for (size_t r = 0; r < rows; ++r) {
+          const uint32_t pred = (r >= stride) ? to_bits(dst[(r - stride) * dst_stride]) : 0u;
+          uint32_t x = 0;
+          if (br.get(1)) {
+            if (br.get(1)) {
+              plz = static_cast<int>(br.get(5));
+              const int len = static_cast<int>(br.get(5)) + 1;
+              ptz = 32 - plz - len;
+              x = br.get(len) << ptz;
+            }
+            else {
+              x = br.get(32 - plz - ptz) << ptz;
+            }
+          }
+          dst[r * dst_stride] = from_bits(x ^ pred);
+        }
+      }
+
+
+      inline bool integral(float x) noexcept
+      {
+        return (x == std::nearbyint(x)) && (std::abs(x) <= 16777216.f) && !(x == 0.f && std::signbit(x));
+      }
+
+    }
+
+
+    // encodes column c of the row-major block [col, col + rows * columns)
+    inline void encode_column(const float* data, size_t rows, size_t columns, size_t c, size_t stride, float step, std::vector<uint8_t>& out)
+    {
+      using namespace detail;
+      const float* col = data + c;
+      bool finite = true, ints = true;
+      for (size_t r = 0; r < rows; ++r) {
+        finite = finite && std::isfinite(col[r * columns]);
+        ints = ints && integral(col[r * columns]);
+      }
+      auto enc = encoding::xor_float;
+      if (step > 0.f && finite) enc = encoding::quantized;
+      else if (ints) enc = encoding::int_delta;
+      out.push_back(static_cast<uint8_t>(enc));
+      if (enc == encoding::quantized) put_pod(out, step);
+      const auto size_pos = out.size();
+      put_pod(out, uint64_t(0));
+      switch (enc) {
+      case encoding::quantized: {
+        std::vector<int64_t> k(rows);
+        for (size_t r = 0; r < rows; ++r) {
+          k[r] = std::llround(static_cast<double>(col[r * columns]) / step);
+          put_varint(out, zigzag(k[r] - ((r >= stride) ? k[r - stride] : 0)));
+        }
+        break;
+      }
+      case encoding::int_delta:
+        for (size_t r = 0; r < rows; ++r) {
+          const auto pred = (r >= stride) ? static_cast<int64_t>(col[(r - stride) * columns]) : 0;
+          put_varint(out, zigzag(static_cast<int64_t>(col[r * columns]) - pred));
+        }
+        break;
+      default:
+        encode_xor(col, rows, columns, stride, out);
+        break;
+      }
+      uint64_t size = out.size() - size_pos - sizeof(uint64_t);
+      if (enc != encoding::quantized && size > rows * sizeof(float)) {
+        // incompressible, store as is
+        out.resize(size_pos - 1);
+        out.push_back(static_cast<uint8_t>(encoding::raw));
+        size = rows * sizeof(float);
+        put_pod(out, size);
+        for (size_t r = 0; r < rows; ++r) put_pod(out, col[r * columns]);
+      }
+      else {
+        std::memcpy(out.data() + size_pos, &size, sizeof(size));
+      }
+    }
+
+
+    // decodes a column block into dst[r * dst_stride], returns the end of the block
+    inline const uint8_t* decode_column(const uint8_t* p, const uint8_t* end, size_t rows, size_t stride, float* dst, size_t dst_stride)
+    {
+      using namespace detail;
+      const auto enc = static_cast<encoding>(get_pod<uint8_t>(p, end));
+      const float step = (enc == encoding::quantized) ? get_pod<float>(p, end) : 0.f;
+      const auto size = get_pod<uint64_t>(p, end);
+      if (size > static_cast<uint64_t>(end - p)) throw std::runtime_error("dcol: truncated column");
+      const uint8_t* last = p + size;
+      switch (enc) {
+      case encoding::quantized: {
+        std::vector<int64_t> k(rows);
+        for (size_t r = 0; r < rows; ++r) {
+          k[r] = unzigzag(get_varint(p, last)) + ((r >= stride) ? k[r - stride] : 0);
+          dst[r * dst_stride] = static_cast<float>(static_cast<double>(k[r]) * step);
+        }
+        break;
+      }
+      case encoding::int_delta:
+        for (size_t r = 0; r < rows; ++r) {
+          const auto pred = (r >= stride) ? static_cast<int64_t>(dst[(r - stride) * dst_stride]) : 0;
+          dst[r * dst_stride] = static_cast<float>(unzigzag(get_varint(p, last)) + pred);
+        }
+        break;
+      case encoding::xor_float:
+        decode_xor(p, last, rows, stride, dst, dst_stride);
+        break;
+      case encoding::raw:
+        if (size != rows * sizeof(float)) throw std::runtime_error("dcol: corrupted raw column");
+        for (size_t r = 0; r < rows; ++r) std::memcpy(dst + r * dst_stride, p + r * sizeof(float), sizeof(float));
+        break;
+      default:
+        throw std::runtime_error("dcol: unknown column encoding");
+      }
+      return last;
+    }
+
+
+    // rows per sample if the first column (time) is constant over
+    // equally sized runs, 1 otherwise
+    inline size_t sample_stride(const float* data, size_t rows, size_t columns)
+    {
+      size_t n = 1;
+      while (n < rows && data[n * columns] == data[0]) ++n;
+      if (n == rows || rows % n) return 1;
+      for (size_t r = 0; r < rows; ++r) {
+        if (data[r * columns] != data[(r - r % n) * columns]) return 1;
+      }
+      return n;
+    }
+
+
+    // writer, runs on the exporter's writer thread
+    class writer : public output_format
+    {
+    public:
+      // step: quantization step per column, 0: lossless
+      writer(const std::filesystem::path& path, const std::string& header, size_t columns, std::vector<float> step = {}) :
+        path_(path), columns_(columns), step_(std::move(step))
+      {
+        step_.resize(columns_, 0.f);
+        os_.open(path_, std::ios::binary);
+        if (!os_) throw std::runtime_error("can't open " + path_.string());
+        file_header fh;
+        fh.columns = static_cast<uint32_t>(columns_);
+        fh.header_size = header.size();
+        os_.write((const char*)&fh, sizeof(fh));
+        os_.write(header.data(), header.size());
+        offset_ = sizeof(fh) + header.size();
+      }
+
+      size_t write(const float* first, size_t n) override
+      {
+        const size_t rows = n / columns_;
+        if (rows == 0) return 0;
+        chunk_header ch;
+        ch.rows = static_cast<uint32_t>(rows);
+        ch.stride = static_cast<uint32_t>(sample_stride(first, rows, columns_));
+        buf_.clear();
+        detail::put_pod(buf_, ch);
+        for (size_t c = 0; c < columns_; ++c) {
+          encode_column(first, rows, columns_, c, ch.stride, step_[c], buf_);
+        }
+        os_.write((const char*)buf_.data(), buf_.size());
+        if (!os_) throw std::runtime_error("can't write " + path_.string());
+        index_.push_back({ offset_, buf_.size(), rows_, ch.rows, first[0], first[(rows - 1) * columns_] });
+        offset_ += buf_.size();
+        rows_ += rows;
+        return buf_.size();
+      }
+
+      void flush() override { os_.flush(); }
+
+      void close() override
+      {
+        if (!os_.is_open()) return;
+        footer ft;
+        ft.index_offset = offset_;
+        ft.chunks = index_.size();
+        os_.write((const char*)index_.data(), index_.size() * sizeof(chunk_entry));
+        os_.write((const char*)&ft, sizeof(ft));
+        os_.close();
+      }
+
+      const std::filesystem::path& path() const noexcept override { return path_; }
+
+    private:
+      std::ofstream os_;
+      std::filesystem::path path_;
+      size_t columns_;
+      std::vector<float> step_;       // quantization steps, 0: lossless
+      std::vector<uint8_t> buf_;
+      std::vector<chunk_entry> index_;
+      uint64_t offset_ = 0;
+      uint64_t rows_ = 0;
+    };
+
+
+    // random access reader over a memory mapped .dcol file
+    class reader
+    {
+    public:
+      explicit reader(const std::filesystem::path& path) : file_(path)
+      {
+        const auto* first = reinterpret_cast<const uint8_t*>(file_.data());
+        const auto* p = first;
+        const auto* end = first + file_.size();
+        const auto fh = detail::get_pod<file_header>(p, end);
+        if (std::memcmp(fh.magic, file_header{}.magic, sizeof(fh.magic))) throw std::runtime_error("dcol: not a dcol file " + path.string());
+        if (fh.version != file_header{}.version) throw std::runtime_error("dcol: version mismatch " + path.string());
+        if (fh.header_size > static_cast<uint64_t>(end - p)) throw std::runtime_error("dcol: truncated header " + path.string());
+        columns_ = fh.columns;
+        header_.assign(reinterpret_cast<const char*>(p), fh.header_size);
+        if (file_.size() < sizeof(footer)) throw std::runtime_error("dcol: truncated file " + path.string());
+        const auto* fp = end - sizeof(footer);
+        const auto ft = detail::get_pod<footer>(fp, end);
+        if (std::memcmp(ft.magic, footer{}.magic, sizeof(ft.magic))) throw std::runtime_error("dcol: incomplete file " + path.string());
+        if (ft.index_offset + ft.chunks * sizeof(chunk_entry) + sizeof(footer) != file_.size()) throw std::runtime_error("dcol: corrupted index " + path.string());
+        index_.resize(ft.chunks);
+        std::memcpy(index_.data(), first + ft.index_offset, ft.chunks * sizeof(chunk_entry));
+        for (const auto& e : index_) rows_ += e.rows;
+      }
+
+      size_t columns() const noexcept { return columns_; }
+      size_t rows() const noexcept { return rows_; }
+      const std::string& header() const noexcept { return header_; }
+      const std::vector<chunk_entry>& chunks() const noexcept { return index_; }
+
+      // row-major rows of chunk i
+      void read_chunk(size_t i, std::vector<float>& out) const
+      {
+        const auto& e = index_.at(i);
+        out.resize(static_cast<size_t>(e.rows) * columns_);
+        const auto* p = chunk_begin(e);
+        const auto* end = p + e.size;
+        const auto ch = detail::get_pod<chunk_header>(p, end);
+        for (size_t c = 0; c < columns_; ++c) {
+          p = decode_column(p, end, ch.rows, ch.stride, out.data() + c, columns_);
+        }
+      }
+
+      // column c of chunk i
+      void read_column(size_t i, size_t c, std::vector<float>& out) const
+      {
+        const auto& e = index_.at(i);
+        if (c >= columns_) throw std::runtime_error("dcol: column out of range");
+        out.resize(e.rows);
+        const auto* p = chunk_begin(e);
+        const auto* end = p + e.size;
+        const auto ch = detail::get_pod<chunk_header>(p, end);
+        for (size_t k = 0; k < c; ++k) {    // skip preceding column blocks
+          const auto enc = static_cast<encoding>(detail::get_pod<uint8_t>(p, end));
+          if (enc == encoding::quantized) detail::get_pod<float>(p, end);
+          const auto size = detail::get_pod<uint64_t>(p, end);
+          if (size > static_cast<uint64_t>(end - p)) throw std::runtime_error("dcol: truncated column");
+          p += size;
+        }
+        decode_column(p, end, ch.rows, ch.stride, out.data(), 1);
+      }
+
+    private:
+      const uint8_t* chunk_begin(const chunk_entry& e) const
+      {
+        if (e.offset + e.size > file_.size()) throw std::runtime_error("dcol: chunk out of range");
+        return reinterpret_cast<const uint8_t*>(file_.data()) + e.offset;
+      }
+
+      mapped_file::reader file_;
+      size_t columns_ = 0;
+      size_t rows_ = 0;
+      std::string header_;
+      std::vector<chunk_entry> index_;
+    };
+
+  }
+}
@@ -3,9 +3,11 @@
 
 
 #include <memory>
-#include <future>
-#include <deque>
-#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
 #include <algorithm>
 #include <tbb/tbb.h>
 #include <hrtree/sorting/insertion_sort.hpp>
@@ -17,63 +19,164 @@ namespace analysis {
 
   namespace diffusion {
 
-    struct snapshot_data
+    // Fixed capacity ring of the last W samples (structure of arrays) and the
+    // pairwise sums between them. Each new sample is paired once with the
+    // W - 1 samples before it, a window row then only reads the sums of its
+    // oldest sample.
+    class window
     {
-      model::vec3 pos;
-      model::vec3 dir;
-      std::vector<model::neighbor_info> ninfo;
-    };
+    public:
+      void reset(size_t W, size_t N, size_t I)
+      {
+        W_ = W; N_ = N; I_ = I;
+        samples_ = 0;
+        nb_.assign(W * N * I, 0);
+        pos_.assign(W * N, model::vec3(0));
+        Q_.assign(W * W, 0);
+        D_.assign(W * W, 0.0);
+      }
 
-    using snapshot_t = std::vector<snapshot_data>;
-    using window_t = std::deque<snapshot_t>;
+      size_t capacity() const noexcept { return W_; }
+      size_t samples() const noexcept { return samples_; }
+      bool full() const noexcept { return samples_ >= W_; }
 
+      // storage of the next sample: N x I neighbor indices, N positions
+      unsigned* next_nb() noexcept { return nb_.data() + slot(samples_) * N_ * I_; }
+      model::vec3* next_pos() noexcept { return pos_.data() + slot(samples_) * N_; }
 
-    // fills 'qmtd' with Qm(t)
-    inline void Qm(const window_t& win, size_t max_topo, float* qmtd)
-    {
-      const auto T = win.size();      // time steps
-      const auto N = win[0].size();   // individuals
-      const auto I = max_topo;        // neighbors to consider
-      auto qmt = std::vector<size_t>(T, 0);
-      auto M0 = std::vector<unsigned>(I);
-      auto Mt = std::vector<unsigned>(I);
-      for (auto n = 0; n < N; ++n) {
-        std::transform(win[0][n].ninfo.cbegin(), win[0][n].ninfo.cbegin() + max_topo, M0.begin(), [](const auto& ni) { return ni.idx; });
-        hrtree::insertion_sort(M0.begin(), M0.end());
-        for (auto t = 1; t < T; ++t) {
-          std::transform(win[t][n].ninfo.cbegin(), win[t][n].ninfo.cbegin() + max_topo, Mt.begin(), [](const auto& ni) { return ni.idx; });
-          hrtree::insertion_sort(Mt.begin(), Mt.end());
-          auto it = std::set_intersection(M0.cbegin(), M0.cend(), Mt.cbegin(), Mt.cend(), Mt.begin());
-          qmt[t] += std::distance(Mt.begin(), it);
+      // completes the next sample: sorts the neighbor sets, centers the
+      // positions and pairs it with the samples in the window
+      void push()
+      {
+        const size_t s = samples_++;
+        unsigned* nb = nb_.data() + slot(s) * N_ * I_;
+        for (size_t n = 0; n < N_; ++n) {
+          hrtree::insertion_sort(nb + n * I_, nb + (n + 1) * I_);
+        }
+        model::vec3* u = pos_.data() + slot(s) * N_;
+        const auto pc = u[0];     // pick one
+        auto cm = model::vec3(0);
+        for (size_t n = 0; n < N_; ++n) cm += math::ofs(pc, u[n]);
+        cm = pc + cm / float(N_);
+        for (size_t n = 0; n < N_; ++n) u[n] = math::ofs(cm, u[n]);
+        for (size_t a = (s >= W_ ? s - W_ + 1 : 0); a <= s; ++a) {
+          const unsigned* nba = nb_.data() + slot(a) * N_ * I_;
+          const model::vec3* ua = pos_.data() + slot(a) * N_;
+          size_t q = 0;
+          double d = 0.0;
+          for (size_t n = 0; n < N_; ++n) {
+            q += intersection_size(nba + n * I_, nb + n * I_);
+            d += glm::distance2(u[n], ua[n]);
+          }
+          Q_[slot(a) * W_ + slot(s)] = q;
+          D_[slot(a) * W_ + slot(s)] = d;
         }
       }
-      std::transform(qmt.cbegin(), qmt.cend(), qmtd, [S = N * I](const auto& x) { return float(double(x) / S); });
-      qmtd[0] = 1.0;
-    }
 
-    // fills 'dev' with r^2(t)
-    inline void R(const window_t& win, float* dev)
+      // Qm(t) and r^2(t) relative to the oldest sample of the full window
+      void row(float* qmtd, float* dev) const
+      {
+        const size_t ref = samples_ - W_;
+        for (size_t t = 0; t < W_; ++t) {
+          const auto i = slot(ref) * W_ + slot(ref + t);
+          qmtd[t] = float(double(Q_[i]) / (N_ * I_));
+          dev[t] = float(D_[i] / (N_ * W_));
+        }
+        qmtd[0] = 1.0;
+      }
+
+    private:
+      size_t slot(size_t sample) const noexcept { return sample % W_; }
+
+      // |a ∩ b| of two sorted sets of I_ elements
+      size_t intersection_size(const unsigned* a, const unsigned* b) const noexcept
+      {
+        size_t res = 0;
+        const unsigned* ae = a + I_;
+        const unsigned* be = b + I_;
+        while (a != ae && b != be) {
+          if (*a < *b) ++a;
+          else if (*b < *a) ++b;
+          else { ++res; ++a; ++b; }
+        }
+        return res;
+      }
+
+      size_t W_ = 0, N_ = 0, I_ = 0;
+      size_t samples_ = 0;
+      std::vector<unsigned> nb_;          // [slot][agent][neighbor], sorted per agent
+      std::vector<model::vec3> pos_;      // [slot][agent], centered after push()
+      std::vector<size_t> Q_;             // [slot a][slot b]: sum of |M(a) ∩ M(b)|
+      std::vector<double> D_;             // [slot a][slot b]: sum of |r(b) - r(a)|^2
+    };
+
+
+    // persistent background thread running one job at a time
+    class worker
     {
-      const auto T = win.size();      // time steps
-      const auto N = win[0].size();   // individuals
-      auto cm = std::vector<model::vec3>(T, { 0,0,0 });
-      for (auto t = 0; t < T; ++t) {
-        // center of mass
-        const auto pc = win[t][0].pos;    // pick one
-        for (auto n = 0; n < N; ++n) {
-          cm[t] += math::ofs(pc, win[t][n].pos);
+    public:
+      worker() : thread_(&worker::loop, this) {}
+
+      ~worker()
+      {
+        {
+          std::lock_guard<std::mutex> _(mutex_);
+          stop_ = true;
         }
-        cm[t] = cm[t] / float(N);
+        cv_.notify_all();
+        thread_.join();
+      }
+
+      // waits for the previous job, then starts job
+      void run(std::function<void()> job)
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wait(lock);
+        job_ = std::move(job);
+        cv_.notify_all();
       }
-      for (auto t = 0; t < T; ++t) {
-        for (auto n = 0; n < N; ++n) {
-          const auto r0 = math::ofs(win[0][n].pos, cm[0]);
-          const auto rt = math::ofs(win[t][n].pos, cm[t]);
-          dev[t] += glm::distance2(rt, r0);
+
+      // blocks until the current job is done, rethrows its exception
+      void wait()
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wait(lock);
+      }
+
+    private:
+      void wait(std::unique_lock<std::mutex>& lock)
+      {
+        cv_.wait(lock, [&]() { return !job_; });
+        if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+      }
+
+      void loop()
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+          cv_.wait(lock, [&]() { return job_ || stop_; });
+          if (!job_) break;
+          lock.unlock();
+          try {
+            job_();
+          }
+          catch (...) {
+            error_ = std::current_exception();
+          }
+          lock.lock();
+          job_ = nullptr;
+          cv_.notify_all();
         }
-        dev[t] /= (N * T);
       }
-    }
+
+      std::mutex mutex_;
+      std::condition_variable cv_;
+      std::function<void()> job_;
+      std::exception_ptr error_;
+      bool stop_ = false;
+      std::thread thread_;
+    };
+
   }
 
 
@@ -97,79 +200,67 @@ namespace analysis {
 
     ~DiffusionObserver()
     {
-      if (future_.valid()) future_.get();
+      try {
+        worker_.wait();
+      }
+      catch (const std::exception& err) {
+        std::cerr << err.what() << std::endl;
+      }
     }
 
   private:
     void notify_init(const model::Simulation& sim) override
     {
       max_topo_ = std::min(sim.pop<Tag>().size() - 1, max_topo_);
-    }
-
-    void notify_pre_collect(const model::Simulation& sim) override
-    {
-      sim.force_neighbor_info_update(true);
+      window_.reset(wsize_, sim.pop<Tag>().size(), max_topo_);
     }
 
     void notify_collect(const model::Simulation& sim) override
     {
-      assert(sim.forced_neighbor_info_update());
-      sim.force_neighbor_info_update(false);
-      if (future_.valid()) future_.get();
+      worker_.wait();     // before the oldest sample is overwritten
       pull_data(sim);
-      if (window_.size() == wsize_) {
-        future_ = std::async(std::launch::async, &DiffusionObserver::analyse, this, sim.tick());
-      }
+      worker_.run([this, tick = sim.tick()]() { analyse(tick); });
     }
 
     void notify_save(const model::Simulation& sim) override
     {
-      if (future_.valid()) future_.get();
-      exporter_(data_.data(), data_.size());
+      worker_.wait();
+      exporter_.submit(data_);
     }
 
     void pull_data(const model::Simulation& sim)
     {
       const auto& pop = sim.pop<Tag>();
-      if (window_.size() == wsize_) {
-        // treat deque as ring-buffer
-        auto oldest = std::move(window_.front());
-        window_.pop_front();
-        window_.emplace_back(std::move(oldest));  // ready for re-use
-      }
-      else {
-        auto state = diffusion::snapshot_t(sim.pop<Tag>().size(), { {}, {}, std::vector<model::neighbor_info>(max_topo_) });
-        window_.emplace_back(std::move(state));
-      }
-      auto& state = window_.back();
+      sim.nearest_neighbors<Tag>(max_topo_, knn_);
+      unsigned* nb = window_.next_nb();
+      model::vec3* pos = window_.next_pos();
       for (size_t i = 0; i < pop.size(); ++i) {
-        auto& pivot = state[i];
-        pivot.pos = pop[i].pos;
-        pivot.dir = pop[i].dir;
-        auto sv = sim.sorted_view<Tag>(i);
-        const auto n = std::min(sv.size(), max_topo_);
-        pivot.ninfo.assign(sv.cbegin(), sv.cbegin() + n);
-        std::fill(pivot.ninfo.begin() + n, pivot.ninfo.end(), model::neighbor_info{});
+        pos[i] = pop[i].pos;
+        for (size_t k = 0; k < max_topo_; ++k) {
+          nb[i * max_topo_ + k] = knn_[i * max_topo_ + k].idx;
+        }
       }
     }
 
+    // runs on the worker
     void analyse(model::tick_t tick)
     {
+      window_.push();
+      if (!window_.full()) return;
       const auto row_size = (1 + 2 * wsize_);
       data_.resize(data_.size() + row_size, 0.f);
       float* p = data_.data() + data_.size() - row_size;
       p[0] = tick;
-      auto fqm = std::async(std::launch::async, diffusion::Qm, window_, max_topo_, p + 1);
-      diffusion::R(window_, p + 1 + wsize_);
-      fqm.get();
+      window_.row(p + 1, p + 1 + wsize_);
     }
 
-    diffusion::window_t window_;
+    diffusion::window window_;
+    std::vector<model::neighbor_info> knn_;
     size_t max_topo_ = 0;
     double dt_;
     size_t wsize_;
-    std::future<void> future_;
     std::vector<float> data_;    // raw data
+    diffusion::worker worker_;   // last member: joined first
   };
 
 }
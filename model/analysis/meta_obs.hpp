@@ -6,11 +6,40 @@
 #include <model/observer.hpp>
 #include <agents/agents.hpp>
 #include <analysis/diffusion_obs.hpp>
+#include <analysis/aggregates_obs.hpp>
+#include <analysis/recorder_obs.hpp>
 
 
 namespace analysis
 {
 	
+	// creates the configured observers writing into 'folder', e.g. for a forked branch
+	template <typename Tag>
+	std::vector<std::unique_ptr<Observer>> CreateObserverChain(const json& J, const path_t& folder)
+	{
+		std::vector<std::unique_ptr<Observer>> res;
+		const auto& js = J["Simulation"];
+		if (!js.contains("Analysis") || js["Analysis"].value("data_folder", std::string{}).empty()) return res;
+		std::filesystem::create_directories(folder);
+
+		const auto& jo = js["Analysis"]["Observers"];
+		for (const auto& j : jo)
+		{
+			std::string type = j["type"];
+			if ('~' != type[0]) {
+				if (type == "TimeSeries") res.emplace_back(std::make_unique<TimeSeriesObserver<Tag>>(folder, j));
+				else if (type == "GroupData") res.emplace_back(std::make_unique<GroupObserver<Tag>>(folder, j));
+				//else if (type == "NeighbData") res.emplace_back(std::make_unique<AllNeighborsObserver<Tag>>(folder, j, N));
+				else if (type == "Diffusion") res.emplace_back(std::make_unique<DiffusionObserver<Tag>>(folder, j));
+				else if (type == "Aggregates") res.emplace_back(std::make_unique<AggregatesObserver<Tag>>(folder, j));
+				else if (type == "Recorder") res.emplace_back(make_recorder<Tag>(folder, j));
+				else throw std::runtime_error("unknown observer");
+			}
+		}
+		return res;
+	}
+
+
 	template <typename Tag>
 	std::vector<std::unique_ptr<Observer>> CreateObserverChain(json& J)
 	{
@@ -31,19 +60,7 @@ namespace analysis
 		// copy json in output folder for reference
 		save_json(J, (unique_path / J["Simulation"]["name"]));
 
-		const auto& jo = ja["Observers"];
-		for (const auto& j : jo)
-		{
-			std::string type = j["type"];
-			if ('~' != type[0]) {
-				if (type == "TimeSeries") res.emplace_back(std::make_unique<TimeSeriesObserver<Tag>>(unique_path, j));
-				else if (type == "GroupData") res.emplace_back(std::make_unique<GroupObserver<Tag>>(unique_path, j));
-				//else if (type == "NeighbData") res.emplace_back(std::make_unique<AllNeighborsObserver<Tag>>(unique_path, j, N));
-				else if (type == "Diffusion") res.emplace_back(std::make_unique<DiffusionObserver<Tag>>(unique_path, j));
-				else throw std::runtime_error("unknown observer");
-			}
-		}
-		return res;
+		return CreateObserverChain<Tag>(J, unique_path);
 	}
 }
 
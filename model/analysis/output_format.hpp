@@ -0,0 +1,104 @@
+#pragma once
+
+// on-disk formats of observer output
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include <model/analysis/bin_file.hpp>
+#include <model/analysis/bin2csv.hpp>
+
+
+namespace analysis {
+
+
+  // column names of a comma separated header
+  inline std::vector<std::string> split_header(const std::string& header)
+  {
+    std::vector<std::string> names;
+    std::string name;
+    for (auto ch : header + ',') {
+      if (ch == ',') { names.push_back(name); name.clear(); }
+      else name.push_back(ch);
+    }
+    return names;
+  }
+
+
+  // Receives whole rows of floats on the exporter's writer thread.
+  class output_format
+  {
+  public:
+    virtual ~output_format() = default;
+    virtual size_t write(const float* first, size_t n) = 0;   // returns bytes written
+    virtual void flush() = 0;
+    virtual void close() = 0;                                  // finalizes the file
+    virtual const std::filesystem::path& path() const noexcept = 0;
+  };
+
+
+  // self-describing row-major float32 (.bin), converted to csv on close
+  class raw_format : public output_format
+  {
+  public:
+    raw_format(const std::filesystem::path& path, const std::string& header, size_t columns, double sample_freq, bool skip_csv) :
+      path_(path), columns_(columns), skip_csv_(skip_csv)
+    {
+      os_.open(path_, std::ios::binary);
+      if (!os_) throw std::runtime_error("can't open " + path_.string());
+      fh_.columns = columns;
+      fh_.sample_freq = sample_freq;
+      fh_.header_size = header.size();
+      fh_.data_offset = (sizeof(fh_) + header.size() + bin::data_alignment - 1) / bin::data_alignment * bin::data_alignment;
+      os_.write((const char*)&fh_, sizeof(fh_));
+      os_.write(header.data(), header.size());
+      const std::string pad(fh_.data_offset - sizeof(fh_) - header.size(), '\0');
+      os_.write(pad.data(), pad.size());
+      auto os = std::ofstream(std::filesystem::path(path_).replace_extension(".csv"));
+      os << header << '\n';
+    }
+
+    size_t write(const float* first, size_t n) override
+    {
+      const size_t rows = n / columns_;
+      for (size_t r = 0; r < rows; ++r) {
+        const float t = first[r * columns_];
+        if (index_.empty() || index_.back().time != t) index_.push_back({ t, fh_.rows + r });
+      }
+      fh_.rows += rows;
+      os_.write((const char*)(first), sizeof(float) * n);
+      if (!os_) throw std::runtime_error("can't write " + path_.string());
+      return sizeof(float) * n;
+    }
+
+    void flush() override { os_.flush(); }
+
+    void close() override
+    {
+      if (os_.is_open()) {
+        // append the time index, complete the header
+        fh_.index_offset = fh_.data_offset + fh_.rows * columns_ * sizeof(float);
+        fh_.index_size = index_.size();
+        os_.write((const char*)index_.data(), index_.size() * sizeof(bin::index_entry));
+        os_.seekp(0);
+        os_.write((const char*)&fh_, sizeof(fh_));
+        os_.close();
+        if (!os_) throw std::runtime_error("can't write " + path_.string());
+        if (!skip_csv_) bin2csv(path_, std::filesystem::path(path_).replace_extension(".csv"));
+      }
+    }
+
+    const std::filesystem::path& path() const noexcept override { return path_; }
+
+  private:
+    std::ofstream os_;
+    std::filesystem::path path_;
+    size_t columns_;
+    bool skip_csv_;
+    bin::file_header fh_;
+    std::vector<bin::index_entry> index_;
+  };
+
+}
@@ -0,0 +1,323 @@
+#pragma once
+
+// Full-state trajectory recordings (.rec)
+//
+// file:  file_header | header string | padding | frames
+// frame: frame_header | column[0] | column[1] | ..   (float32 per agent, 64 byte aligned)
+//
+// Frames are written in large block aligned chunks with direct I/O from a
+// dedicated thread. 'frames' and 'dropped' are filled in when the file is
+// closed; for interrupted runs the frame count follows from the file size.
+// Dropped frames leave gaps in the frame ticks.
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <filesystem>
+#include <stdexcept>
+#include <libs/direct_file.hpp>
+#include <libs/mapped_file.hpp>
+
+
+namespace analysis {
+  namespace rec {
+
+
+    // recorded columns
+    enum col : size_t { posx, posy, posz, dirx, diry, dirz, speed, beta, state, substate, n_columns };
+
+    constexpr const char* header = "posx,posy,posz,dirx,diry,dirz,speed,beta,state,substate";
+
+
+    struct file_header
+    {
+      char magic[8] = { 'D', 'N', 'C', 'S', 'R', 'E', 'C', '\0' };
+      uint32_t version = 1;
+      uint32_t species = 0;           // species index
+      uint64_t agents = 0;
+      uint64_t columns = n_columns;
+      double dt = 0.0;                // [s] per tick
+      uint64_t stride = 1;            // [ticks] between frames
+      uint64_t column_bytes = 0;      // [bytes] per column, 64 byte aligned
+      uint64_t frame_bytes = 0;       // [bytes] per frame
+      uint64_t frames = 0;            // 0 until closed
+      uint64_t dropped = 0;           // frames lost to back-pressure
+      uint64_t header_size = 0;       // [bytes] of the header string following
+      uint64_t data_offset = 0;       // [bytes] first frame, block aligned
+    };
+
+
+    struct frame_header
+    {
+      int64_t tick = 0;
+      char reserved[56] = {};
+    };
+
+
+    // file_header for 'agents' agents, frames and columns laid out
+    inline file_header make_header(uint32_t species, size_t agents, double dt, uint64_t stride)
+    {
+      file_header fh;
+      fh.species = species;
+      fh.agents = agents;
+      fh.dt = dt;
+      fh.stride = stride;
+      fh.column_bytes = (agents * sizeof(float) + 63) & ~size_t(63);
+      fh.frame_bytes = sizeof(frame_header) + fh.columns * fh.column_bytes;
+      fh.header_size = std::strlen(header);
+      fh.data_offset = direct_file::round_up(sizeof(file_header) + fh.header_size);
+      return fh;
+    }
+
+
+    // recorder back-pressure metrics
+    struct write_stats
+    {
+      size_t frames = 0;        // recorded frames
+      size_t dropped = 0;       // frames dropped, no free chunk
+      size_t chunks = 0;        // chunks written
+      size_t bytes = 0;         // bytes written
+      size_t stalls = 0;        // frames that waited for a free chunk
+      double stall_ms = 0.0;    // [ms] accumulated waiting time
+      double write_ms = 0.0;    // [ms] spent in write calls
+      size_t max_queued = 0;    // deepest write queue observed
+    };
+
+
+    // Frames are filled in place into a pool of aligned chunks, full chunks
+    // are written by a dedicated thread. Without a free chunk, frames are
+    // either dropped or the caller waits ('block').
+    class writer
+    {
+    public:
+      writer(const std::filesystem::path& path, const file_header& fh, size_t chunk_bytes, size_t chunks, bool block, bool direct_io) :
+        fh_(fh), block_(block)
+      {
+        // chunks must cover whole blocks of the file: a multiple of the
+        // smallest block aligned group of frames, at least one group
+        const size_t align = direct_file::block_size / std::gcd(size_t(fh_.frame_bytes), direct_file::block_size);
+        chunk_frames_ = std::max(size_t(1), chunk_bytes / fh_.frame_bytes / align) * align;
+        chunk_bytes_ = direct_file::round_up(chunk_frames_ * fh_.frame_bytes);
+        for (size_t i = 0; i < std::max(size_t(2), chunks); ++i) {
+          pool_.emplace_back(direct_file::make_aligned_buffer(chunk_bytes_));
+          free_.push_back(pool_.back().get());
+        }
+        file_.open(path, direct_io);
+        write_header();
+        thread_ = std::thread(&writer::write_loop, this);
+      }
+
+      ~writer()
+      {
+        try {
+          close();
+        }
+        catch (const std::exception& err) {
+          std::cerr << err.what() << std::endl;
+        }
+      }
+
+      // returns the frame for 'tick' to fill, nullptr: dropped
+      char* begin_frame(int64_t tick)
+      {
+        if (!cur_) {
+          std::unique_lock<std::mutex> lock(mutex_);
+          if (error_) std::rethrow_exception(error_);
+          if (free_.empty()) {
+            if (!block_) {
+              ++stats_.dropped;
+              return nullptr;
+            }
+            const auto t0 = std::chrono::steady_clock::now();
+            cv_.wait(lock, [&]() { return !free_.empty() || error_; });
+            ++stats_.stalls;
+            stats_.stall_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+            if (error_) std::rethrow_exception(error_);
+          }
+          cur_ = free_.back();
+          free_.pop_back();
+          cur_frames_ = 0;
+        }
+        char* frame = cur_ + cur_frames_ * fh_.frame_bytes;
+        reinterpret_cast<frame_header*>(frame)->tick = tick;
+        return frame;
+      }
+
+      // commits the frame returned by begin_frame
+      void end_frame()
+      {
+        ++frames_;
+        if (++cur_frames_ == chunk_frames_) submit();
+      }
+
+      // writes the pending frames and finalizes the file
+      void close()
+      {
+        if (!file_.is_open()) return;
+        if (cur_) submit();
+        {
+          std::lock_guard<std::mutex> _(mutex_);
+          stop_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+        const auto error = error_;
+        fh_.frames = stats_.frames = frames_;
+        fh_.dropped = stats_.dropped;
+        if (!error) {
+          write_header();
+          file_.truncate(fh_.data_offset + frames_ * fh_.frame_bytes);
+        }
+        file_.close();
+        if (error) std::rethrow_exception(error);
+      }
+
+      write_stats stats() const
+      {
+        std::lock_guard<std::mutex> _(mutex_);
+        auto res = stats_;
+        res.frames = frames_;
+        return res;
+      }
+
+      const file_header& layout() const noexcept { return fh_; }
+      bool direct() const noexcept { return file_.direct(); }
+      size_t chunk_bytes() const noexcept { return chunk_bytes_; }
+      size_t chunks() const noexcept { return pool_.size(); }
+      const std::filesystem::path& path() const noexcept { return file_.path(); }
+
+    private:
+      struct chunk
+      {
+        char* buf;
+        size_t bytes;
+        uint64_t ofs;
+      };
+
+      void write_header()
+      {
+        auto block = direct_file::make_aligned_buffer(fh_.data_offset);
+        std::memcpy(block.get(), &fh_, sizeof(fh_));
+        std::memcpy(block.get() + sizeof(fh_), header, fh_.header_size);
+        file_.write_at(block.get(), fh_.data_offset, 0);
+      }
+
+      void submit()
+      {
+        const auto bytes = cur_frames_ * fh_.frame_bytes;
+        std::memset(cur_ + bytes, 0, direct_file::round_up(bytes) - bytes);   // padding of a partial last chunk
+        {
+          std::lock_guard<std::mutex> _(mutex_);
+          queue_.push_back({ cur_, bytes, fh_.data_offset + (frames_ - cur_frames_) * fh_.frame_bytes });
+          stats_.max_queued = std::max(stats_.max_queued, queue_.size());
+        }
+        cv_.notify_all();
+        cur_ = nullptr;
+      }
+
+      void write_loop()
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+          cv_.wait(lock, [&]() { return !queue_.empty() || stop_; });
+          if (queue_.empty()) break;    // stop_ and drained
+          const auto c = queue_.front();
+          queue_.pop_front();
+          const bool failed = error_ != nullptr;
+          lock.unlock();
+          std::exception_ptr error;
+          const auto t0 = std::chrono::steady_clock::now();
+          try {
+            if (!failed) file_.write_at(c.buf, direct_file::round_up(c.bytes), c.ofs);
+          }
+          catch (...) {
+            error = std::current_exception();
+          }
+          const auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+          lock.lock();
+          if (error && !error_) error_ = error;
+          stats_.write_ms += ms;
+          stats_.bytes += c.bytes;
+          ++stats_.chunks;
+          free_.push_back(c.buf);
+          cv_.notify_all();
+        }
+      }
+
+      file_header fh_;
+      direct_file::writer file_;
+      std::vector<direct_file::aligned_buffer> pool_;
+      size_t chunk_frames_ = 0;
+      size_t chunk_bytes_ = 0;
+      bool block_ = false;
+
+      // producer side
+      char* cur_ = nullptr;
+      size_t cur_frames_ = 0;
+      size_t frames_ = 0;
+
+      mutable std::mutex mutex_;
+      std::condition_variable cv_;
+      std::deque<chunk> queue_;       // pending writes
+      std::vector<char*> free_;       // recycled chunks
+      bool stop_ = false;
+      std::exception_ptr error_;
+      write_stats stats_;
+      std::thread thread_;
+    };
+
+
+    // memory mapped reader
+    class reader
+    {
+    public:
+      explicit reader(const std::filesystem::path& path) : path_(path), file_(path)
+      {
+        if (file_.size() < sizeof(file_header) || std::memcmp(file_.data(), file_header{}.magic, sizeof(file_header{}.magic))) {
+          throw std::runtime_error("rec: not a recording " + path_.string());
+        }
+        std::memcpy(&fh_, file_.data(), sizeof(fh_));
+        if (fh_.version != file_header{}.version) throw std::runtime_error("rec: version mismatch " + path_.string());
+        if (fh_.columns != n_columns || fh_.frame_bytes == 0 || fh_.data_offset > file_.size()) throw std::runtime_error("rec: corrupted header " + path_.string());
+        const size_t avail = (file_.size() - fh_.data_offset) / fh_.frame_bytes;
+        frames_ = fh_.frames ? std::min<size_t>(fh_.frames, avail) : avail;
+      }
+
+      size_t agents() const noexcept { return fh_.agents; }
+      size_t frames() const noexcept { return frames_; }
+      size_t dropped() const noexcept { return fh_.dropped; }
+      size_t species() const noexcept { return fh_.species; }
+      double dt() const noexcept { return fh_.dt; }
+      uint64_t stride() const noexcept { return fh_.stride; }
+      const std::filesystem::path& path() const noexcept { return path_; }
+
+      int64_t tick(size_t f) const noexcept { return file_.as<frame_header>(frame_offset(f))->tick; }
+      double time(size_t f) const noexcept { return tick(f) * fh_.dt; }
+
+      // column 'c' of frame 'f', one value per agent
+      const float* column(size_t f, size_t c) const noexcept
+      {
+        return file_.as<float>(frame_offset(f) + sizeof(frame_header) + c * fh_.column_bytes);
+      }
+
+    private:
+      size_t frame_offset(size_t f) const noexcept { return fh_.data_offset + f * fh_.frame_bytes; }
+
+      std::filesystem::path path_;
+      mapped_file::reader file_;
+      file_header fh_;
+      size_t frames_ = 0;
+    };
+
+  }
+}
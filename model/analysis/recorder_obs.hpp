@@ -0,0 +1,152 @@
+#ifndef RECORDER_OBS_HPP_INCLUDED
+#define RECORDER_OBS_HPP_INCLUDED
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <iostream>
+#include <stdexcept>
+#include <model/observer.hpp>
+#include <model/analysis/rec_file.hpp>
+#include <agents/agents.hpp>
+
+
+namespace analysis {
+
+  // Full-state trajectory recorder (.rec, see rec_file.hpp), every tick by default.
+  // Bypasses cvs_exporter: the columns are copied straight into large aligned
+  // chunks written with direct I/O by a dedicated thread.
+  // "sample_freq": [s], 0: every tick; "chunk_mb": chunk size; "chunks": chunks
+  // in the pool; "on_full": "drop" (default) or "block" when the writer falls
+  // behind; "direct_io": false for buffered writes; "species": recorded species.
+  template <typename Tag>
+  class RecorderObserver : public model::Observer
+  {
+  public:
+    RecorderObserver(const std::filesystem::path& out_path, const json& J) :
+      path_(out_path / (std::string(J["output_name"]) + ".rec"))
+    {
+      const auto freq_sec = optional_json<double>(J, "sample_freq").value_or(0.0);
+      stride_ = std::max(tick_t(1), static_cast<tick_t>(std::llround(freq_sec / model::Simulation::dt())));
+      chunk_bytes_ = static_cast<size_t>(optional_json<double>(J, "chunk_mb").value_or(16.0) * (1 << 20));
+      chunks_ = optional_json<size_t>(J, "chunks").value_or(4);
+      direct_io_ = optional_json<bool>(J, "direct_io").value_or(true);
+      const auto on_full = optional_json<std::string>(J, "on_full").value_or("drop");
+      if (on_full != "drop" && on_full != "block") throw std::runtime_error("Recorder: unknown on_full '" + on_full + "'");
+      block_ = (on_full == "block");
+    }
+
+    tick_t wake_tick() const noexcept override { return next_tick_; }
+
+    void receive(long long lmsg, const model::Simulation& sim) override
+    {
+      using Msg = model::Simulation::Msg;
+      switch (Msg(lmsg)) {
+      case Msg::Initialized: {
+        finish();
+        agents_ = sim.pop<Tag>().size();
+        const auto fh = rec::make_header(Tag::value, agents_, model::Simulation::dt(), stride_);
+        writer_ = std::make_unique<rec::writer>(path_, fh, chunk_bytes_, chunks_, block_, direct_io_);
+        next_tick_ = sim.tick() + stride_;
+        warned_ = false;
+        break;
+      }
+      case Msg::Tick:
+        if (writer_ && sim.tick() >= next_tick_) {
+          record(sim);
+          next_tick_ = sim.tick() + stride_;
+        }
+        break;
+      case Msg::Finished:
+        finish();
+        break;
+      default:
+        break;
+      }
+    }
+
+    ~RecorderObserver() override
+    {
+      try {
+        finish();
+      }
+      catch (const std::exception& err) {
+        std::cerr << err.what() << std::endl;
+      }
+    }
+
+  private:
+    void record(const model::Simulation& sim)
+    {
+      if (sim.pop<Tag>().size() != agents_) throw std::runtime_error("Recorder: population size changed");
+      char* frame = writer_->begin_frame(sim.tick());
+      if (!frame) {
+        if (!warned_) {
+          std::cerr << path_.filename().string() << ": writer behind, dropping frames from tick " << sim.tick() << std::endl;
+          warned_ = true;
+        }
+        return;
+      }
+      float* col[rec::n_columns];
+      for (size_t c = 0; c < rec::n_columns; ++c) {
+        col[c] = reinterpret_cast<float*>(frame + sizeof(rec::frame_header) + c * writer_->layout().column_bytes);
+      }
+      sim.parallel_visit_all<Tag>([&](const auto& p, size_t idx) {
+        const auto si = p.get_current_state();
+        col[rec::posx][idx] = p.pos.x;
+        col[rec::posy][idx] = p.pos.y;
+        col[rec::posz][idx] = p.pos.z;
+        col[rec::dirx][idx] = p.dir.x;
+        col[rec::diry][idx] = p.dir.y;
+        col[rec::dirz][idx] = p.dir.z;
+        col[rec::speed][idx] = p.speed;
+        col[rec::beta][idx] = static_cast<float>(p.H.beta());
+        col[rec::state][idx] = static_cast<float>(si.state());
+        col[rec::substate][idx] = static_cast<float>(si.sub_state());
+      });
+      writer_->end_frame();
+    }
+
+    // closes the recording and reports drops and back-pressure
+    void finish()
+    {
+      if (!writer_) return;
+      auto writer = std::move(writer_);
+      writer->close();
+      const auto ws = writer->stats();
+      const auto name = path_.filename().string();
+      std::cout << name << ": " << ws.frames << " frames, " << (ws.bytes >> 20) << " MB"
+                << (writer->direct() ? " direct" : " buffered");
+      if (ws.write_ms > 0) std::cout << " at " << static_cast<size_t>(ws.bytes / 1048.576 / ws.write_ms) << " MB/s";
+      std::cout << std::endl;
+      if (ws.dropped) std::cout << name << ": dropped " << ws.dropped << " frames (writer behind, max queue " << ws.max_queued << ")" << std::endl;
+      if (ws.stalls) std::cout << name << ": simulation stalled " << ws.stalls << " times (" << ws.stall_ms << " ms)" << std::endl;
+    }
+
+    std::filesystem::path path_;
+    tick_t stride_ = 1;           // [ticks]
+    size_t chunk_bytes_ = 0;
+    size_t chunks_ = 4;
+    bool direct_io_ = true;
+    bool block_ = false;
+    size_t agents_ = 0;
+    tick_t next_tick_ = 0;
+    bool warned_ = false;
+    std::unique_ptr<rec::writer> writer_;
+  };
+
+
+  // Recorder of the species named by the optional "species" entry, default: Tag
+  template <typename Tag>
+  std::unique_ptr<model::Observer> make_recorder(const std::filesystem::path& out_path, const json& J)
+  {
+    const auto species = optional_json<std::string>(J, "species");
+    if (!species) return std::make_unique<RecorderObserver<Tag>>(out_path, J);
+    if (*species == model::Prey::name()) return std::make_unique<RecorderObserver<model::prey_tag>>(out_path, J);
+    if (*species == model::Pred::name()) return std::make_unique<RecorderObserver<model::pred_tag>>(out_path, J);
+    throw std::runtime_error("Recorder: unknown species '" + *species + "'");
+  }
+
+}
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef REPLAY_HPP_INCLUDED
+#define REPLAY_HPP_INCLUDED
+
+// Offline re-analysis of recorded runs (.rec, see recorder_obs.hpp)
+//
+// The recordings of a run folder drive a Simulation through
+// Simulation::replay() instead of update(); the configured observers see
+// it as usual. Only the frames an observer samples or a group detection
+// needs are loaded. Nearest neighbors and groups are recomputed from the
+// recorded positions through their spatial indices. PreTick is not
+// replayed, species without recording keep their initial state.
+
+#include <array>
+#include <chrono>
+#include <limits>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <filesystem>
+#include <tbb/parallel_for.h>
+#include <model/simulation.hpp>
+#include <model/observer.hpp>
+#include <model/analysis/rec_file.hpp>
+#include <model/analysis/meta_obs.hpp>
+
+
+namespace analysis {
+  namespace replay {
+
+    // folders at or below 'root' holding recordings, sorted
+    inline std::vector<std::filesystem::path> find_runs(const std::filesystem::path& root)
+    {
+      std::vector<std::filesystem::path> res;
+      auto has_rec = [](const std::filesystem::path& dir) {
+        for (const auto& e : std::filesystem::directory_iterator(dir)) {
+          if (e.is_regular_file() && e.path().extension() == ".rec") return true;
+        }
+        return false;
+      };
+      if (has_rec(root)) res.push_back(root);
+      for (const auto& e : std::filesystem::recursive_directory_iterator(root)) {
+        if (e.is_directory() && has_rec(e.path())) res.push_back(e.path());
+      }
+      std::sort(res.begin(), res.end());
+      return res;
+    }
+
+
+    // agents of frame 'f'
+    inline void load_frame(const rec::reader& r, size_t f, std::vector<model::recorded_state>& out, bool serial)
+    {
+      out.resize(r.agents());
+      const float* c[rec::n_columns];
+      for (size_t i = 0; i < rec::n_columns; ++i) c[i] = r.column(f, i);
+      auto body = [&](const tbb::blocked_range<size_t>& range) {
+        for (size_t i = range.begin(); i < range.end(); ++i) {
+          auto& rs = out[i];
+          rs.pos = glm::vec3(c[rec::posx][i], c[rec::posy][i], c[rec::posz][i]);
+          rs.dir = glm::vec3(c[rec::dirx][i], c[rec::diry][i], c[rec::dirz][i]);
+          rs.speed = c[rec::speed][i];
+          rs.beta = c[rec::beta][i];
+          rs.state = model::state_info_t{};
+          rs.state.state(static_cast<size_t>(c[rec::state][i]));
+          rs.state.sub_state(static_cast<size_t>(c[rec::substate][i]));
+        }
+      };
+      if (serial) body(tbb::blocked_range<size_t>(0, out.size()));
+      else tbb::parallel_for(tbb::blocked_range<size_t>(0, out.size()), body);
+    }
+
+
+    struct run_stats
+    {
+      size_t frames = 0;        // recorded frames
+      size_t loaded = 0;        // frames replayed
+      size_t samples = 0;       // frames an observer sampled
+      double ms = 0.0;          // [ms]
+    };
+
+
+    // Replays the recordings in 'folder' through the observers configured in J,
+    // writing into 'out_folder'. J: composed config of the recorded run.
+    // 'neighbor_info': recompute the sorted neighbor info at sampled frames.
+    template <typename Tag>
+    run_stats run(json J, const std::filesystem::path& folder, const std::filesystem::path& out_folder, bool neighbor_info, bool serial)
+    {
+      const auto t0 = std::chrono::steady_clock::now();
+      auto& jo = J["Simulation"]["Analysis"]["Observers"];
+      jo.erase(std::remove_if(jo.begin(), jo.end(), [](const json& j) { return j["type"] == "Recorder"; }), jo.end());
+
+      std::vector<rec::reader> readers;
+      for (const auto& e : std::filesystem::directory_iterator(folder)) {
+        if (e.is_regular_file() && e.path().extension() == ".rec") readers.emplace_back(e.path());
+      }
+      std::sort(readers.begin(), readers.end(), [](const auto& a, const auto& b) { return a.path() < b.path(); });
+      if (readers.empty()) throw std::runtime_error("replay: no recordings in " + folder.string());
+
+      auto sim = std::make_unique<model::Simulation>(J);    // before observers, sets dt
+      sim->serial(serial);
+      std::array<bool, model::n_species> recorded{};
+      for (const auto& r : readers) {
+        if (r.species() >= model::n_species || recorded[r.species()]) throw std::runtime_error("replay: unexpected species in " + r.path().string());
+        if (float(r.dt()) != model::Simulation::dt()) throw std::runtime_error("replay: dt mismatch " + r.path().string());
+        recorded[r.species()] = true;
+      }
+      auto observers = CreateObserverChain<Tag>(J, out_folder);
+      auto head = model::ObserverScheduler{};
+      for (auto& obs : observers) head.append_observer(obs.get());
+
+      // the first recording leads, the others join at equal ticks
+      const auto& lead = readers.front();
+      std::vector<size_t> cursor(readers.size(), 0);
+      std::array<std::vector<model::recorded_state>, model::n_species> frame;
+      auto load = [&](size_t f) {
+        const auto tick = lead.tick(f);
+        for (size_t i = 0; i < readers.size(); ++i) {
+          const auto& r = readers[i];
+          while (cursor[i] < r.frames() && r.tick(cursor[i]) < tick) ++cursor[i];
+          if (cursor[i] < r.frames() && r.tick(cursor[i]) == tick) load_frame(r, cursor[i], frame[r.species()], serial);
+          else frame[r.species()].clear();
+        }
+      };
+
+      run_stats stats;
+      stats.frames = lead.frames();
+      if (lead.frames()) {
+        load(0);
+        sim->replay(lead.tick(0), frame, neighbor_info);
+        ++stats.loaded;
+      }
+      head.notify(model::Simulation::Initialized, *sim);
+      for (size_t f = 1; f < lead.frames(); ++f) {
+        const auto tick = lead.tick(f);
+        auto wake = std::numeric_limits<model::tick_t>::max();
+        for (const auto& obs : observers) wake = std::min(wake, obs->wake_tick());
+        const bool sample = tick >= wake;
+        if (!sample && tick <= sim->next_group_detection()) continue;
+        load(f);
+        sim->replay(tick, frame, neighbor_info && sample);
+        ++stats.loaded;
+        if (sample) {
+          head.notify(model::Simulation::Tick, *sim);
+          ++stats.samples;
+        }
+      }
+      head.notify(model::Simulation::Finished, *sim);
+      stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+      return stats;
+    }
+
+  }
+}
+
+#endif
@@ -0,0 +1,91 @@
+#include <fstream>
+#include <model/checkpoint.hpp>
+#include <model/simulation.hpp>
+
+
+namespace model {
+  namespace checkpoint {
+
+
+    std::vector<char> snapshot(const Simulation& sim)
+    {
+      oarchive ar;
+      ar.pod(header{});
+      sim.save(ar);
+      auto& buf = ar.buffer();
+      header h;
+      h.config_hash = sim.config_hash();
+      h.payload = buf.size() - sizeof(header);
+      std::memcpy(buf.data(), &h, sizeof(header));
+      return std::move(buf);
+    }
+
+
+    void restore(Simulation& sim, const std::vector<char>& image)
+    {
+      iarchive ar(image.data(), image.data() + image.size());
+      header h;
+      ar.pod(h);
+      if (std::memcmp(h.magic, header{}.magic, sizeof(h.magic))) throw std::runtime_error("checkpoint: not a checkpoint");
+      if (h.version != header::current_version) throw std::runtime_error("checkpoint: version mismatch");
+      if (h.endian != header{}.endian) throw std::runtime_error("checkpoint: endianness mismatch");
+      if (h.config_hash != sim.config_hash()) throw std::runtime_error("checkpoint: config mismatch");
+      if (h.payload != ar.remaining()) throw std::runtime_error("checkpoint: truncated");
+      sim.load(ar);
+    }
+
+
+    std::vector<char> read(const std::filesystem::path& path)
+    {
+      std::ifstream is(path, std::ios::binary);
+      if (!is) throw std::runtime_error("can't open checkpoint " + path.string());
+      std::vector<char> image(std::filesystem::file_size(path));
+      is.read(image.data(), image.size());
+      if (!is) throw std::runtime_error("can't read checkpoint " + path.string());
+      return image;
+    }
+
+
+    async_writer::async_writer(const std::filesystem::path& folder, size_t keep) :
+      folder_(folder), keep_(std::max(size_t(1), keep))
+    {
+      std::filesystem::create_directories(folder_);
+    }
+
+
+    async_writer::~async_writer()
+    {
+      try { wait(); } catch (...) {}
+    }
+
+
+    void async_writer::write(const std::string& filename, std::vector<char>&& image)
+    {
+      wait();
+      pending_ = std::async(std::launch::async, [this, filename, image = std::move(image)]() {
+        const auto path = folder_ / filename;
+        auto tmp = path;
+        tmp += ".tmp";
+        {
+          std::ofstream os(tmp, std::ios::binary | std::ios::trunc);
+          os.write(image.data(), image.size());
+          if (!os) throw std::runtime_error("can't write checkpoint " + tmp.string());
+        }
+        std::filesystem::rename(tmp, path);
+        written_.push_back(path);
+        while (written_.size() > keep_) {
+          std::error_code ec;
+          std::filesystem::remove(written_.front(), ec);
+          written_.pop_front();
+        }
+      });
+    }
+
+
+    void async_writer::wait()
+    {
+      if (pending_.valid()) pending_.get();
+    }
+
+  }
+}
@@ -0,0 +1,139 @@
+#ifndef MODEL_CHECKPOINT_HPP_INCLUDED
+#define MODEL_CHECKPOINT_HPP_INCLUDED
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+#include <future>
+#include <filesystem>
+#include <stdexcept>
+#include <type_traits>
+
+
+namespace model {
+
+  class Simulation;
+
+  namespace checkpoint {
+
+    // checkpoint file layout: header | payload (Simulation::save)
+    struct header
+    {
+      static constexpr uint32_t current_version = 5;
+
+      char magic[8] = { 'D', 'N', 'C', 'S', 'C', 'K', 'P', 'T' };
+      uint32_t version = current_version;
+      uint32_t endian = 0x01020304;
+      uint64_t config_hash = 0;     // hash over the state-relevant config sections
+      uint64_t payload = 0;         // [bytes] following the header
+    };
+
+
+    // binary output archive, trivially copyable types only
+    class oarchive
+    {
+    public:
+      template <typename T>
+      oarchive& pod(const T& x)
+      {
+        static_assert(std::is_trivially_copyable_v<T>, "checkpoint: type not trivially copyable");
+        const auto p = reinterpret_cast<const char*>(std::addressof(x));
+        buf_.insert(buf_.end(), p, p + sizeof(T));
+        return *this;
+      }
+
+      // size-prefixed sequence
+      template <typename T>
+      oarchive& seq(const std::vector<T>& v)
+      {
+        static_assert(std::is_trivially_copyable_v<T>, "checkpoint: type not trivially copyable");
+        pod(static_cast<uint64_t>(v.size()));
+        const auto p = reinterpret_cast<const char*>(v.data());
+        buf_.insert(buf_.end(), p, p + v.size() * sizeof(T));
+        return *this;
+      }
+
+      std::vector<char>& buffer() noexcept { return buf_; }
+
+    private:
+      std::vector<char> buf_;
+    };
+
+
+    // binary input archive, counterpart of oarchive
+    class iarchive
+    {
+    public:
+      iarchive(const char* first, const char* last) : cur_(first), last_(last) {}
+
+      template <typename T>
+      iarchive& pod(T& x)
+      {
+        static_assert(std::is_trivially_copyable_v<T>, "checkpoint: type not trivially copyable");
+        read(std::addressof(x), sizeof(T));
+        return *this;
+      }
+
+      template <typename T>
+      iarchive& seq(std::vector<T>& v)
+      {
+        static_assert(std::is_trivially_copyable_v<T>, "checkpoint: type not trivially copyable");
+        uint64_t n = 0;
+        pod(n);
+        if (n > remaining() / sizeof(T)) throw std::runtime_error("checkpoint: corrupted sequence");
+        v.resize(n);
+        read(v.data(), n * sizeof(T));
+        return *this;
+      }
+
+      size_t remaining() const noexcept { return static_cast<size_t>(last_ - cur_); }
+
+    private:
+      void read(void* dst, size_t n)
+      {
+        if (n > remaining()) throw std::runtime_error("checkpoint: unexpected end of data");
+        std::memcpy(dst, cur_, n);
+        cur_ += n;
+      }
+
+      const char* cur_;
+      const char* last_;
+    };
+
+
+    // returns complete image (header included) of the simulation state
+    std::vector<char> snapshot(const Simulation& sim);
+
+    // restores simulation state from image.
+    // sim shall be constructed from the same config the image was taken from.
+    void restore(Simulation& sim, const std::vector<char>& image);
+
+    // reads image from file
+    std::vector<char> read(const std::filesystem::path& path);
+
+
+    // writes images on a background thread, at most one write in flight.
+    // Files are written to a temporary and renamed when complete;
+    // only the last 'keep' checkpoints are retained.
+    class async_writer
+    {
+    public:
+      async_writer(const std::filesystem::path& folder, size_t keep);
+      ~async_writer();
+
+      void write(const std::string& filename, std::vector<char>&& image);
+      void wait();
+
+    private:
+      std::filesystem::path folder_;
+      size_t keep_;
+      std::future<void> pending_;
+      std::deque<std::filesystem::path> written_;
+    };
+
+  }
+}
+
+#endif
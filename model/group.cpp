@@ -1,7 +1,7 @@
 #include <queue>
 #include <algorithm>
 #include <libs/graph.hpp>
-#include <glmutils/oobb.hpp>
+#include <glmutils/oobb_batch.hpp>
 #include <model/math.hpp>
 #include <agents/agents.hpp>
 #include <model/group.hpp>
@@ -11,27 +11,214 @@ namespace model {
 
   void group_tracker::cluster(float dd)
   {
-    group_id_.assign(proxy_.size(), no_group);
-    const auto n = proxy_.size();
-    auto cc = graph::connected_components(0, static_cast<int>(n), [&](int i, int j) {
-      return dd > glm::distance2(proxy_[i].pos, proxy_[j].pos);
-    });
+    const auto n = static_cast<unsigned>(proxy_.size());
+    prev_id_.swap(group_id_);
+    prev_label_.resize(descr_.size());
+    for (size_t g = 0; g < descr_.size(); ++g) prev_label_[g] = descr_[g].label;
+    group_id_.assign(n, no_group);
     descr_.clear();
-    for (unsigned ci = 0; ci < static_cast<unsigned>(cc.size()); ++ci) {
-      vpos_.clear();
-      vvel_.clear();
-      vec3 vel = vec3(0);
-      for (auto i : cc[ci]) {
-        group_id_[proxy_[i].idx] = ci;
-        vpos_.emplace_back(math::ofs(proxy_[cc[ci][0]].pos, proxy_[i].pos));
-        vvel_.emplace_back(proxy_[i].vel);
-        vel += proxy_[i].vel;
-      }
-      vec3 ext;
-      auto H = glmutils::oobb(static_cast<int>(cc[ci].size()), vpos_.begin(), ext);
-      vel /= cc[ci].size();
-      H[2] += glm::vec4(proxy_[cc[ci][0]].pos, 0.f);
-      descr_.push_back({ vpos_.size(), vel, H, ext });
+    events_.clear();
+    if (n == 0) return;
+
+    const auto alive = [&](unsigned i) { return proxy_[i].idx != no_group; };
+    if (levels_.empty()) {
+      // merge pairs closer than threshold, candidates from the grid
+      grid_.build(n, std::sqrt(dd), [&](size_t i) { return proxy_[i].pos; });
+      uf_.reset(n);
+      tbb::parallel_for(tbb::blocked_range<unsigned>(0, n, 256), [&](const auto& r) {
+        for (auto i = r.begin(); i < r.end(); ++i) {
+          if (proxy_[i].idx == no_group) continue;
+          const auto pos = proxy_[i].pos;
+          grid_.visit_neighbors(pos, [&](unsigned j) {
+            if (j > i && proxy_[j].idx != no_group && dd > glm::distance2(pos, proxy_[j].pos)) {
+              uf_.unite(i, j);
+            }
+          });
+        }
+      });
+    }
+    else {
+      // single linkage: components at threshold t are joined by the
+      // forest edges shorter than t
+      spanning_forest(std::max(dd, levels_.back().threshold * levels_.back().threshold));
+      for (auto& level : levels_) {
+        const auto ldd = level.threshold * level.threshold;
+        uf_.reset(n);
+        for (auto it = msf_.cbegin(); it != msf_.cend() && ldd > it->d2; ++it) uf_.unite(it->i, it->j);
+        const auto groups = graph::label_sets(uf_, level.group_id, alive);
+        level.descr.resize(groups);
+        build_members(level.group_id, groups, level_offsets_, level_members_);
+        describe(level_offsets_, level_members_, level.descr, nullptr);
+      }
+      uf_.reset(n);
+      for (auto it = msf_.cbegin(); it != msf_.cend() && dd > it->d2; ++it) uf_.unite(it->i, it->j);
+    }
+
+    // roots are the minimum members: numbering roots in ascending order
+    // yields the group ids of the former BFS over [0, n)
+    const auto groups = graph::label_sets(uf_, group_id_, alive);
+    descr_.resize(groups);
+    build_members(group_id_, groups, offsets_, members_);
+    aggregates_.resize(groups);
+    describe(offsets_, members_, descr_, aggregates_.data());
+    match_labels();
+  }
+
+
+  void group_tracker::hierarchy(std::vector<float> thresholds)
+  {
+    std::sort(thresholds.begin(), thresholds.end());
+    levels_.resize(thresholds.size());
+    for (size_t i = 0; i < thresholds.size(); ++i) {
+      levels_[i].threshold = thresholds[i];
+    }
+  }
+
+
+  // Kruskal over the grid candidate pairs closer than sqrt(dd)
+  void group_tracker::spanning_forest(float dd)
+  {
+    const auto n = static_cast<unsigned>(proxy_.size());
+    grid_.build(n, std::sqrt(dd), [&](size_t i) { return proxy_[i].pos; });
+    tbb::enumerable_thread_specific<std::vector<edge>> tls_edges;
+    tbb::parallel_for(tbb::blocked_range<unsigned>(0, n, 256), [&](const auto& r) {
+      auto& edges = tls_edges.local();
+      for (auto i = r.begin(); i < r.end(); ++i) {
+        if (proxy_[i].idx == no_group) continue;
+        const auto pos = proxy_[i].pos;
+        grid_.visit_neighbors(pos, [&](unsigned j) {
+          if (j > i && proxy_[j].idx != no_group) {
+            const auto d2 = glm::distance2(pos, proxy_[j].pos);
+            if (dd > d2) edges.push_back({ d2, i, j });
+          }
+        });
+      }
+    });
+    std::vector<edge> candidates;
+    for (auto& edges : tls_edges) {
+      candidates.insert(candidates.end(), edges.cbegin(), edges.cend());
+    }
+    tbb::parallel_sort(candidates.begin(), candidates.end(), [](const edge& a, const edge& b) {
+      return (a.d2 < b.d2) || (a.d2 == b.d2 && (a.i < b.i || (a.i == b.i && a.j < b.j)));
+    });
+    uf_.reset(n);
+    msf_.clear();
+    for (const auto& e : candidates) {
+      if (uf_.find(e.i) != uf_.find(e.j)) {
+        uf_.unite(e.i, e.j);
+        msf_.push_back(e);
+      }
+    }
+  }
+
+
+  // group descriptors and optional aggregates from CSR group -> members
+  void group_tracker::describe(const std::vector<unsigned>& offsets, const std::vector<unsigned>& members, std::vector<group_descr>& descr, group_aggregates* aggregates)
+  {
+    const auto groups = static_cast<unsigned>(descr.size());
+    vpos_.resize(members.size());
+    vH_.resize(groups);
+    vext_.resize(groups);
+    tbb::parallel_for(tbb::blocked_range<unsigned>(0, groups, 16), [&](const auto& r) {
+      for (auto g = r.begin(); g < r.end(); ++g) {
+        const auto ref = proxy_[members[offsets[g]]].pos;
+        vec3 vel = vec3(0);
+        vec3 heading = vec3(0);
+        vec3 centroid = vec3(0);
+        float speed = 0.f;
+        for (auto m = offsets[g]; m < offsets[g + 1]; ++m) {
+          const auto& p = proxy_[members[m]];
+          vpos_[m] = math::ofs(ref, p.pos);
+          centroid += vpos_[m];
+          vel += p.vel;
+          heading += math::save_normalize(p.vel, vec3(0.f));
+          speed += glm::length(p.vel);
+        }
+        const auto n = static_cast<float>(offsets[g + 1] - offsets[g]);
+        descr[g].size = offsets[g + 1] - offsets[g];
+        descr[g].vel = vel / n;
+        if (aggregates) {
+          aggregates[g] = { ref + centroid / n, speed / n, glm::length(heading / n) };
+        }
+      }
+      glmutils::oobb_batch(r.begin(), r.end(), offsets.data(), vpos_.data(), vH_.data(), vext_.data());
+      for (auto g = r.begin(); g < r.end(); ++g) {
+        auto H = vH_[g];
+        H[2] += glm::vec4(proxy_[members[offsets[g]]].pos, 0.f);
+        descr[g].H = H;
+        descr[g].ext = vext_[g];
+      }
+    });
+  }
+
+
+  // Carries labels over from the previous detection.
+  // A current group inherits the label of the previous group it shares
+  // most members with, if that previous group in turn has most of its
+  // surviving members in it. Otherwise the group gets a fresh label and
+  // a split event is recorded; previous groups that lost their label to
+  // a larger one are recorded as merged.
+  void group_tracker::match_labels()
+  {
+    const auto n = static_cast<unsigned>(group_id_.size());
+    const auto prev_groups = static_cast<unsigned>(prev_label_.size());
+    const auto groups = static_cast<unsigned>(descr_.size());
+    overlap_.clear();
+    for (unsigned i = 0; i < std::min(n, static_cast<unsigned>(prev_id_.size())); ++i) {
+      if (group_id_[i] != no_group && prev_id_[i] != no_group) {
+        overlap_.push_back((static_cast<uint64_t>(prev_id_[i]) << 32) | group_id_[i]);
+      }
+    }
+    tbb::parallel_sort(overlap_.begin(), overlap_.end());
+
+    // largest overlaps, ties to the lower id
+    std::vector<unsigned> best_curr_count(prev_groups, 0);
+    std::vector<unsigned> best_prev_count(groups, 0);
+    best_curr_.assign(prev_groups, no_group);
+    best_prev_.assign(groups, no_group);
+    for (size_t first = 0; first < overlap_.size();) {
+      auto last = first + 1;
+      while (last < overlap_.size() && overlap_[last] == overlap_[first]) ++last;
+      const auto p = static_cast<unsigned>(overlap_[first] >> 32);
+      const auto g = static_cast<unsigned>(overlap_[first]);
+      const auto count = static_cast<unsigned>(last - first);
+      if (count > best_curr_count[p]) { best_curr_count[p] = count; best_curr_[p] = g; }
+      if (count > best_prev_count[g]) { best_prev_count[g] = count; best_prev_[g] = p; }
+      first = last;
+    }
+
+    for (unsigned g = 0; g < groups; ++g) {
+      const auto p = best_prev_[g];
+      if (p != no_group && best_curr_[p] == g) {
+        descr_[g].label = prev_label_[p];
+      }
+      else {
+        descr_[g].label = next_label_++;
+        if (p != no_group) events_.push_back({ group_event::split, descr_[g].label, prev_label_[p] });
+      }
+    }
+    for (unsigned p = 0; p < prev_groups; ++p) {
+      const auto g = best_curr_[p];
+      if (g != no_group && best_prev_[g] != p) {
+        events_.push_back({ group_event::merge, descr_[g].label, prev_label_[p] });
+      }
+    }
+  }
+
+
+  // CSR group -> members, ascending
+  void group_tracker::build_members(const std::vector<unsigned>& group_id, size_t groups, std::vector<unsigned>& offsets, std::vector<unsigned>& members)
+  {
+    const auto n = group_id.size();
+    offsets.assign(groups + 1, 0);
+    for (size_t i = 0; i < n; ++i) {
+      if (group_id[i] != no_group) ++offsets[group_id[i] + 1];
+    }
+    for (size_t g = 0; g < groups; ++g) offsets[g + 1] += offsets[g];
+    members.resize(offsets[groups]);
+    fill_.assign(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < n; ++i) {
+      if (group_id[i] != no_group) members[fill_[group_id[i]]++] = static_cast<unsigned>(i);
     }
   }
 
@@ -43,6 +230,12 @@ namespace model {
       vec3 gc = fd.gc();
       fd.H[2] = gc + dt * fd.vel;
     }
+    for (auto& level : levels_) {
+      for (auto& fd : level.descr) {
+        vec3 gc = fd.gc();
+        fd.H[2] = gc + dt * fd.vel;
+      }
+    }
   }
 
 }
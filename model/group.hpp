@@ -2,7 +2,11 @@
 #define MODEL_GROUP_HPP_INCLUDED
 
 #include <vector>
+#include <span>
+#include <libs/graph.hpp>
+#include <libs/spatial_hash.hpp>
 #include <model/model.hpp>
+#include <model/checkpoint.hpp>
 
 
 namespace model {
@@ -14,10 +18,36 @@ namespace model {
     vec3 vel = vec3(0);  // velocity, required for tracking in `track()`
     glm::mat3x3 H;       // homogeneous transformation matrix group -> Euclidean
 	  vec3 ext;
+    unsigned label = 0;  // persistent across detections
 
     vec3 gc() const { return vec3(H[2]); }
   };
 
+  // per-group aggregates, cached at clustering time
+  struct group_aggregates
+  {
+    vec3 centroid = vec3(0);
+    float mean_speed = 0.f;
+    float polarization = 0.f;     // length of the mean heading
+  };
+
+  // label change between two detections
+  struct group_event
+  {
+    enum kind_t : unsigned { split, merge };
+    kind_t kind;
+    unsigned label;   // split: new group, merge: surviving group
+    unsigned other;   // split: parent group, merge: absorbed group
+  };
+
+  // groups at an additional detection threshold
+  struct group_level
+  {
+    float threshold = 0.f;
+    std::vector<unsigned> group_id;
+    std::vector<group_descr> descr;   // labels not tracked
+  };
+
   constexpr unsigned no_group = static_cast<unsigned>(-1);
 
 
@@ -41,9 +71,37 @@ namespace model {
       return (static_cast<size_t>(id) < descr_.size()) ? descr_[id] : group_descr{};
     }
 
+    // -1 before the first detection
     int id_of(size_t idx) const noexcept
     {
-      return group_id_[idx];
+      return (idx < group_id_.size()) ? group_id_[idx] : -1;
+    }
+
+    // members of group id in ascending order
+    std::span<const unsigned> members(int id) const noexcept
+    {
+      if (static_cast<size_t>(id) >= descr_.size()) return {};
+      return { members_.data() + offsets_[id], members_.data() + offsets_[id + 1] };
+    }
+
+    const std::vector<group_aggregates>& aggregates() const noexcept
+    {
+      return aggregates_;
+    }
+
+    // groups at the thresholds passed to hierarchy(), ascending
+    const std::vector<group_level>& levels() const noexcept
+    {
+      return levels_;
+    }
+
+    // additional thresholds resolved at every detection
+    void hierarchy(std::vector<float> thresholds);
+
+    // splits and merges found by the last detection
+    const std::vector<group_event>& events() const noexcept
+    {
+      return events_;
     }
 
     void prepare(size_t n)
@@ -60,7 +118,25 @@ namespace model {
     void cluster(float dd);
     void track();
 
+    void save(checkpoint::oarchive& ar) const 
+    { 
+      ar.seq(descr_).seq(aggregates_).seq(group_id_).seq(events_).pod(next_label_);
+      for (const auto& level : levels_) ar.seq(level.group_id).seq(level.descr);
+    }
+
+    void load(checkpoint::iarchive& ar) 
+    { 
+      ar.seq(descr_).seq(aggregates_).seq(group_id_).seq(events_).pod(next_label_);
+      for (auto& level : levels_) ar.seq(level.group_id).seq(level.descr);
+      build_members(group_id_, descr_.size(), offsets_, members_);
+    }
+
   private:
+    void build_members(const std::vector<unsigned>& group_id, size_t groups, std::vector<unsigned>& offsets, std::vector<unsigned>& members);
+    void describe(const std::vector<unsigned>& offsets, const std::vector<unsigned>& members, std::vector<group_descr>& descr, group_aggregates* aggregates);
+    void spanning_forest(float dd);
+    void match_labels();
+
     struct proxy 
     { 
       proxy() : idx(static_cast<unsigned>(-1)) {}
@@ -76,9 +152,29 @@ namespace model {
     };
     std::vector<proxy> proxy_;
     std::vector<group_descr> descr_;
-    std::vector<vec3> vpos_;
-    std::vector<vec3> vvel_;
+    std::vector<group_aggregates> aggregates_;
     std::vector<unsigned> group_id_;
+    spatial_hash::grid grid_;
+    graph::concurrent_disjoint_set uf_;
+    std::vector<unsigned> members_;       // agents ordered by group, ascending
+    std::vector<unsigned> offsets_;       // group -> first member
+    std::vector<unsigned> fill_;
+    std::vector<unsigned> prev_id_;       // group ids of the previous detection
+    std::vector<unsigned> prev_label_;    // labels of the previous groups
+    std::vector<uint64_t> overlap_;       // (previous, current) group pairs
+    std::vector<unsigned> best_prev_;     // current -> largest overlapping previous group
+    std::vector<unsigned> best_curr_;     // previous -> largest overlapping current group
+    std::vector<group_event> events_;
+    unsigned next_label_ = 0;
+
+    struct edge { float d2; unsigned i, j; };
+    std::vector<edge> msf_;               // minimum spanning forest, ascending d2
+    std::vector<group_level> levels_;
+    std::vector<unsigned> level_offsets_;
+    std::vector<unsigned> level_members_;
+    std::vector<vec3> vpos_;              // member positions relative to the first member, CSR
+    std::vector<glm::mat4> vH_;
+    std::vector<vec3> vext_;
   };
 
 }
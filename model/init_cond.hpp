@@ -3,9 +3,16 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <vector>
 #include <string>
 #include <filesystem>
+#include <charconv>
+#include <cstring>
+#include <atomic>
+#include <tbb/tbb.h>
+#include <libs/mapped_file.hpp>
+#include <model/analysis/bin_file.hpp>
 #include <glmutils/random.hpp>
 #include <model/math.hpp>
 #include <model/simulation.hpp>
@@ -34,27 +41,140 @@ namespace initial_conditions {
   };
 
   
+  namespace detail {
+
+    // parses up to n comma separated floats from [first, last).
+    // returns the number of values parsed.
+    inline size_t parse_csv_row(const char* first, const char* last, float* out, size_t n)
+    {
+      size_t i = 0;
+      while ((i < n) && (first < last)) {
+        while ((first < last) && (*first == ' ' || *first == '\t')) ++first;
+        auto [ptr, ec] = std::from_chars(first, last, out[i]);
+        if (ec != std::errc{}) break;
+        ++i;
+        first = static_cast<const char*>(std::memchr(ptr, ',', last - ptr));
+        if (!first) break;
+        ++first;
+      }
+      return i;
+    }
+
+  }
+
+  
   // config key: csv
+  // the file is memory mapped, rows are parsed in parallel.
+  // Rows the fast parser rejects fall back to Instance::stream_from_csv.
   class from_csv
   { 
   public:
-	 from_csv(const json& J) :
-		csv_(std::filesystem::path(std::string(J["file"])))
-		{
-			csv_.ignore(2048, '\n');    // skip header
-		}
+    from_csv(const json& J) :
+      csv_(std::filesystem::path(std::string(J["file"])))
+    {}
 
     template <typename Instance>
-    void operator()(Instance& instance)
+    void fill(std::vector<Instance>& vse)
     {
-	  // function reads only one line
-        Instance::stream_from_csv(csv_, instance);
-	  // delete line that has been read already
-	    csv_.ignore(2048, '\n'); 
+      // collect line starts, skip header
+      std::vector<const char*> lines;
+      lines.reserve(vse.size() + 2);
+      const char* last = csv_.end();
+      const char* p = static_cast<const char*>(std::memchr(csv_.begin(), '\n', csv_.size()));
+      while (p && (++p < last) && (lines.size() < vse.size())) {
+        lines.push_back(p);
+        p = static_cast<const char*>(std::memchr(p, '\n', last - p));
+      }
+      if (lines.size() < vse.size()) throw std::runtime_error("csv initializer: not enough rows");
+      lines.push_back(last);
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, vse.size()), [&](const auto& r) {
+        float row[Instance::csv_columns];
+        for (size_t i = r.begin(); i < r.end(); ++i) {
+          const auto eol = std::min(lines[i + 1], last);
+          if (Instance::csv_columns == detail::parse_csv_row(lines[i], eol, row, Instance::csv_columns)) {
+            Instance::from_csv_row(row, vse[i]);
+          }
+          else {
+            // other delimiters, '+' signs etc. through the stream parser
+            std::istringstream is(std::string(lines[i], eol));
+            if (!Instance::stream_from_csv(is, vse[i])) {
+              throw std::runtime_error("csv initializer: malformed row " + std::to_string(i + 1));
+            }
+          }
+        }
+      });
     }
 
   private:
-    std::ifstream csv_;
+    mapped_file::reader csv_;
+  };
+
+
+  // config key: bin
+  // "file" is either a packed array of float32 [pos.xyz, dir.xyz] records
+  // or, if "time" is given, the binary output of a TimeSeries observer. In the
+  // latter case the column layout is taken from the file (or the .csv sidecar
+  // of older outputs) and the frame sampled closest to "time" is used.
+  // Instances are matched by 'id'.
+  class from_bin
+  {
+  public:
+    from_bin(const json& J) :
+      path_(std::string(J["file"])),
+      time_(optional_json<double>(J, "time"))
+    {}
+
+    template <typename Instance>
+    void fill(std::vector<Instance>& vse)
+    {
+      if (time_) fill_frame(vse);
+      else fill_packed(vse);
+    }
+
+  private:
+    template <typename Instance>
+    void fill_packed(std::vector<Instance>& vse)
+    {
+      const auto bin = mapped_file::reader(path_);
+      if (bin.size() < vse.size() * 6 * sizeof(float)) throw std::runtime_error("bin initializer: not enough records");
+      const float* data = bin.as<float>();
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, vse.size()), [&](const auto& r) {
+        for (size_t i = r.begin(); i < r.end(); ++i) {
+          const float* rec = data + 6 * i;
+          vse[i].pos = model::vec3(rec[0], rec[1], rec[2]);
+          vse[i].dir = model::vec3(rec[3], rec[4], rec[5]);
+        }
+      });
+    }
+
+    template <typename Instance>
+    void fill_frame(std::vector<Instance>& vse)
+    {
+      const auto bin = analysis::bin::reader(path_);
+      const size_t cid = bin.column("id");
+      const size_t cp[3] = { bin.column("posx"), bin.column("posy"), bin.column("posz") };
+      const size_t cd[3] = { bin.column("dirx"), bin.column("dirz"), bin.column("diry") };   // TimeSeries order: dir.x, dir.z, dir.y
+      if (bin.rows() == 0) throw std::runtime_error("bin initializer: empty file");
+      const auto [lo, end] = bin.sample(*time_);
+      if ((end - lo) != vse.size()) throw std::runtime_error("bin initializer: frame size doesn't match population size");
+      std::vector<std::atomic<bool>> seen(vse.size());
+      tbb::parallel_for(tbb::blocked_range<size_t>(lo, end), [&](const auto& r) {
+        for (size_t row = r.begin(); row < r.end(); ++row) {
+          const float* rec = bin.row(row);
+          if (!(rec[cid] >= 0.f && rec[cid] < static_cast<float>(vse.size()))) throw std::runtime_error("bin initializer: id out of range");
+          const auto id = static_cast<size_t>(rec[cid]);
+          if (seen[id].exchange(true)) throw std::runtime_error("bin initializer: duplicate id " + std::to_string(id));
+          vse[id].pos = model::vec3(rec[cp[0]], rec[cp[1]], rec[cp[2]]);
+          vse[id].dir = model::vec3(rec[cd[0]], rec[cd[1]], rec[cd[2]]);
+        }
+      });
+      for (size_t id = 0; id < seen.size(); ++id) {
+        if (!seen[id]) throw std::runtime_error("bin initializer: missing id " + std::to_string(id));
+      }
+    }
+
+    std::filesystem::path path_;
+    std::optional<double> time_;
   };
 
 
@@ -60,6 +60,16 @@ namespace model {
     state_info_t state;      
   };
 
+
+  // recorded state of one agent, see Simulation::replay()
+  struct recorded_state {
+    vec3 pos;
+    vec3 dir;
+    float speed;
+    float beta;              // banking angle
+    state_info_t state;
+  };
+
 }
 
 #endif
@@ -3,6 +3,10 @@
 
 #include <vector>
 #include <array>
+#include <iostream>
+#include <chrono>
+#include <limits>
+#include <algorithm>
 #include <model/json.hpp>
 #include "analysis/analysis.hpp"
 
@@ -17,8 +21,11 @@ namespace model {
   {
   public:
     virtual ~Observer() {};
+
+    // handles msg and passes it down the chain
     virtual void notify(long long msg, const class Simulation& sim)
     {
+      receive(msg, sim);
       notify_next(msg, sim);
     }
 
@@ -38,6 +45,13 @@ namespace model {
       if (next_) next_->notify_once(sim);
     }
 
+    // handles msg for this observer only
+    virtual void receive(long long msg, const class Simulation& sim) {}
+
+    // Next tick that requires Tick (PreTick one tick earlier), 0: every tick.
+    // Queried by ObserverScheduler after each Tick this observer received.
+    virtual tick_t wake_tick() const noexcept { return 0; }
+
     virtual imgui_handler* gui_handler() { return nullptr; }
     Observer* next() noexcept { return next_; }
 
@@ -47,10 +61,29 @@ namespace model {
   };
 
 
+  // Head of the observer chain owned by the run loop.
+  // PreTick and Tick are delivered only to the observers due, concurrently
+  // and read-only (see Simulation::shared_read); all other messages
+  // travel down the chain.
+  class ObserverScheduler : public Observer
+  {
+  public:
+    void notify(long long lmsg, const class Simulation& sim) override;
+
+  private:
+    void dispatch(long long lmsg, const class Simulation& sim, tick_t now);
+
+    std::vector<Observer*> observers_;
+    std::vector<Observer*> due_;
+    tick_t next_wake_ = 0;
+  };
+
+
   class AnalysisObserver : public model::Observer
   {
   public:
     size_t columns() const noexcept { return exporter_.columns(); }
+    analysis::write_stats io_stats() const { return exporter_.stats(); }
 
     AnalysisObserver(const std::filesystem::path& out_path, const json& J) :
       exporter_(out_path, J) 
@@ -68,27 +101,42 @@ namespace model {
       size_t cached_rows;
     };
 
-	  void notify(long long lmsg, const model::Simulation& sim)
-	  {
-		  using Msg = model::Simulation::Msg;
-		  auto msg = Msg(lmsg);
-
-		  switch (msg) {
-		  case Msg::Tick: {
-        notify_tick(sim);
-			  if (sim.tick() >= oi_.sample_tick) {
-				  notify_collect(sim);
-				  oi_.sample_tick = sim.tick() + oi_.sample_freq;
-			  }
-			  if (data_out_.size() > columns() * oi_.cached_rows) // avoid overflow 
-			  {
-				  notify_save(sim);
-				  data_out_.clear();
-			  }
-			  break;
-		  }
+    // time spent collecting samples
+    struct collect_stats
+    {
+      size_t samples = 0;
+      double total_ms = 0.0;    // [ms]
+      double max_ms = 0.0;      // [ms]
+    };
+
+    const collect_stats& collect_timing() const noexcept { return cs_; }
+
+    tick_t wake_tick() const noexcept override { return oi_.sample_tick; }
+
+    void receive(long long lmsg, const model::Simulation& sim) override
+    {
+      using Msg = model::Simulation::Msg;
+      auto msg = Msg(lmsg);
+
+      switch (msg) {
+      case Msg::Tick: {
+        if (sim.tick() >= oi_.sample_tick) {
+          const auto t0 = std::chrono::steady_clock::now();
+          notify_collect(sim);
+          const auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+          ++cs_.samples;
+          cs_.total_ms += ms;
+          cs_.max_ms = std::max(cs_.max_ms, ms);
+          oi_.sample_tick = next_sample_tick(sim.tick());
+          if (data_out_.size() > columns() * oi_.cached_rows) // avoid overflow 
+          {
+            notify_save(sim);
+            data_out_.clear();
+          }
+        }
+        break;
+      }
       case Msg::PreTick: {
-        notify_pre_tick(sim);
         if ((sim.tick() + 1) >= oi_.sample_tick) {
           notify_pre_collect(sim);
         }
@@ -98,28 +146,73 @@ namespace model {
         notify_init(sim);
         break;
       case Msg::Finished:
-			  notify_save(sim);
-			  break;
+        notify_save(sim);
+        exporter_.flush();    // all data on disk when Finished returns
+        if (const auto ws = exporter_.stats(); ws.stalls) {
+          std::cout << exporter_.path().filename().string() << ": output stalled " << ws.stalls << " times (" << ws.stall_ms << " ms)" << std::endl;
+        }
+        if (cs_.samples) {
+          std::cout << exporter_.path().filename().string() << ": " << cs_.total_ms / cs_.samples << " ms per sample (max " << cs_.max_ms << " ms)" << std::endl;
+        }
+        break;
       default:
         break;
-		  }
-		  notify_next(lmsg, sim);
-	  }
+      }
+    }
 
   protected:
     virtual void notify_init(const model::Simulation&) {};
-    virtual void notify_tick(const model::Simulation&) {};
-    virtual void notify_pre_tick(const model::Simulation&) {};
     virtual void notify_collect(const model::Simulation&) {};
     virtual void notify_pre_collect(const model::Simulation&) {};
     virtual void notify_save(const model::Simulation&) {};
+
+    // tick of the next sample after the one at 'now'
+    virtual tick_t next_sample_tick(tick_t now) const { return now + oi_.sample_freq; }
 	   
   protected:
 	  obs_info oi_;
+	  collect_stats cs_;
 	  std::vector<float> data_out_;
     analysis::cvs_exporter exporter_;
   };
 
+
+  inline void ObserverScheduler::notify(long long lmsg, const model::Simulation& sim)
+  {
+    using Msg = model::Simulation::Msg;
+    switch (Msg(lmsg)) {
+    case Msg::PreTick:
+      if (sim.tick() + 1 >= next_wake_) dispatch(lmsg, sim, sim.tick() + 1);
+      break;
+    case Msg::Tick:
+      if (sim.tick() >= next_wake_) {
+        dispatch(lmsg, sim, sim.tick());
+        next_wake_ = std::numeric_limits<tick_t>::max();
+        for (auto* obs : observers_) next_wake_ = std::min(next_wake_, obs->wake_tick());
+      }
+      break;
+    case Msg::Initialized:
+      observers_.clear();
+      for (auto* obs = next(); obs; obs = obs->next()) observers_.push_back(obs);
+      next_wake_ = 0;
+      Observer::notify(lmsg, sim);
+      break;
+    default:
+      Observer::notify(lmsg, sim);
+      break;
+    }
+  }
+
+
+  inline void ObserverScheduler::dispatch(long long lmsg, const model::Simulation& sim, tick_t now)
+  {
+    due_.clear();
+    for (auto* obs : observers_) {
+      if (obs->wake_tick() <= now) due_.push_back(obs);
+    }
+    sim.shared_read(due_.size(), [&](size_t i) { due_[i]->receive(lmsg, sim); });
+  }
+
 }
 
 #endif
@@ -5,6 +5,7 @@
 #include <agents/agents.hpp>
 #include <model/simulation.hpp>
 #include <model/observer.hpp>
+#include <model/checkpoint.hpp>
 
 
 namespace model {
@@ -12,7 +13,7 @@ namespace model {
 
   thread_local rndutils::default_engine reng = rndutils::make_random_engine<>();
  
-  float Simulation::dt_;
+  std::atomic<float> Simulation::dt_;
 
   namespace {
 
@@ -71,6 +72,11 @@ namespace model {
         for (auto& ut : sa[I].update_times) {
           ut = ut_dist(reng);
         }
+        sa[I].rng.resize(N);
+        for (auto& rng : sa[I].rng) {
+          rng.seed(reng());
+        }
+        for (auto& P : sa[I].spos) P.resize(N);
         apply_cross<0>(J, sa);
         init_simulation_impl<I + 1>::apply(J, pop, sa, sim);
         for (size_t i = 0; i < N; ++i) {
@@ -107,6 +113,30 @@ namespace model {
     }
   
 
+    // parallel loop over agents, inline loop for serial simulations
+    template <typename Body>
+    void for_each_agent(const Simulation* sim, size_t n, Body&& body)
+    {
+      if (sim->serial()) body(tbb::blocked_range<size_t>(0, n));
+      else tbb::parallel_for(tbb::blocked_range<size_t>(0, n), body);
+    }
+
+
+    // refreshes the structure-of-arrays position tables
+    template <size_t S>
+    void refresh_positions(const species_pop& pop, state_array& sa)
+    {
+      const auto& pops = std::get<S>(pop);
+      auto& P = sa[S].spos;
+      for (size_t i = 0; i < pops.size(); ++i) {
+        P[0][i] = pops[i].pos.x;
+        P[1][i] = pops[i].pos.y;
+        P[2][i] = pops[i].pos.z;
+      }
+      if constexpr (S < n_species - 1) refresh_positions<S + 1>(pop, sa);
+    }
+
+
     struct radix_sort_converter
     {
       static const int key_bytes = sizeof(float);
@@ -147,12 +177,26 @@ namespace model {
         //    }
         //}
         
-        auto first = SNI.begin() + (popj.size() * idx);
+        // distances from the position tables, vectorizable
+        const auto n = popj.size();
+        const float* __restrict px = sa[J].spos[0].data();
+        const float* __restrict py = sa[J].spos[1].data();
+        const float* __restrict pz = sa[J].spos[2].data();
+        thread_local std::vector<float> dist2;
+        dist2.resize(n);
+        float* __restrict dd = dist2.data();
+        for (size_t j = 0; j < n; ++j) {
+          const float dx = px[j] - pos.x;
+          const float dy = py[j] - pos.y;
+          const float dz = pz[j] - pos.z;
+          dd[j] = dx * dx + dy * dy + dz * dz;
+        }
+        auto first = SNI.begin() + (n * idx);
         auto it = first;
-        for (unsigned j = 0; j < popj.size(); ++j, ++it) {
+        for (unsigned j = 0; j < n; ++j, ++it) {
           *it = {
-             glm::distance2(pos, popj[j].pos),
-             popj[j].pos,
+             dd[j],
+             vec3(px[j], py[j], pz[j]),
              j,
              popj[j].stress,
              popj[j].get_current_state()
@@ -169,13 +213,19 @@ namespace model {
     {
       auto& pops = std::get<S>(pop);
       auto& uts = std::get<S>(sa).update_times;
+      auto& rngs = std::get<S>(sa).rng;
       const auto T = sim->tick();
       const auto forced_ni_update = sim->forced_neighbor_info_update();
-      tbb::parallel_for(tbb::blocked_range<size_t>(0, pops.size()), [&, sim, T](auto r) {
+      for_each_agent(sim, pops.size(), [&, sim, T](auto r) {
         for (size_t i = r.begin(); i < r.end(); ++i) {
           const auto update = uts[i] <= T;
           if (update || forced_ni_update) update_neighbor_info<S>::apply(sim, i, sa);
-          if (update) uts[i] = pops[i].update(i, T, *sim);
+          if (update) {
+            // agent's own random stream: independent from thread scheduling
+            std::swap(reng, rngs[i]);
+            uts[i] = pops[i].update(i, T, *sim);
+            std::swap(reng, rngs[i]);
+          }
         }
       });
       update_species<S + 1>(sim, pop, sa);
@@ -192,7 +242,7 @@ namespace model {
       auto& pops = std::get<S>(pop);
       auto& uts = std::get<S>(sa).update_times;
       const auto T = sim->tick();
-      tbb::parallel_for(tbb::blocked_range<size_t>(0, pops.size()), [&, sim, T](auto r) {
+      for_each_agent(sim, pops.size(), [&, sim, T](auto r) {
         for (size_t i = r.begin(); i < r.end(); ++i) {
           if (uts[i] != static_cast<tick_t>(-1)) {
             pops[i].integrate(T, *sim);
@@ -215,7 +265,7 @@ namespace model {
       auto& fts = std::get<S>(sa).ftracker;
       fts.prepare(pops.size());
       const auto T = sim->tick();
-      tbb::parallel_for(tbb::blocked_range<size_t>(0, pops.size()), [&, sim, T](auto r) {
+      for_each_agent(sim, pops.size(), [&, sim, T](auto r) {
         for (size_t i = r.begin(); i < r.end(); ++i) {
           if (uts[i] != static_cast<tick_t>(-1)) {
             pops[i].integrate(T, *sim);
@@ -231,6 +281,215 @@ namespace model {
     void integrate_species_group<model::n_species>(Simulation*, species_pop&, state_array&, float)
     {}
 
+
+    template <size_t S>
+    void fill_snapshot(const Simulation* sim, const species_pop& pop, const state_array& sa, state_snapshot& snap)
+    {
+      const auto& pops = std::get<S>(pop);
+      const auto& ss = std::get<S>(sa);
+      auto& sp = std::get<S>(snap.species);
+      const size_t n = pops.size();
+      sp.instances.resize(n);
+      sp.pos.resize(n);
+      sp.dir.resize(n);
+      sp.stress.resize(n);
+      sp.group.resize(n);
+      sp.nnd.resize(n);
+      for_each_agent(sim, n, [&](auto r) {
+        for (size_t i = r.begin(); i < r.end(); ++i) {
+          const auto& a = pops[i];
+          sp.instances[i] = a.instance_proxy(i, sim);
+          sp.pos[i] = a.pos;
+          sp.dir[i] = a.dir;
+          sp.stress[i] = a.stress;
+          sp.group[i] = ss.ftracker.id_of(i);
+          sp.nnd[i] = (n > 1) ? std::sqrt(ss.SNI[S][i * n + 1].dist2) : 0.f;    // [0] is 'self'
+        }
+      });
+      if constexpr (S < n_species - 1) fill_snapshot<S + 1>(sim, pop, sa, snap);
+    }
+
+
+    // k nearest agents of species S2 for all agents of species S1, see Simulation::nearest_neighbors
+    template <size_t S1, size_t S2>
+    void nearest_neighbors_of(const Simulation* sim, const spatial_hash::grid& grid, const std::vector<vec3>& pos, size_t k, std::vector<neighbor_info>& out)
+    {
+      const auto& popi = sim->pop<std::integral_constant<size_t, S1>>();
+      const auto& popj = sim->pop<std::integral_constant<size_t, S2>>();
+      const size_t n = popj.size();
+      const size_t kk = std::min(k, n - ((S1 == S2 && n) ? 1 : 0));
+      const float cell = grid.cell_size();
+      out.resize(popi.size() * k);
+      for_each_agent(sim, popi.size(), [&](auto r) {
+        thread_local std::vector<std::pair<float, unsigned>> best;    // (dist2, idx) ascending
+        best.resize(kk);
+        for (size_t i = r.begin(); i < r.end(); ++i) {
+          const auto p = popi[i].pos;
+          size_t m = 0;
+          auto consider = [&](unsigned j) {
+            if (S1 == S2 && j == i) return;
+            const auto d = pos[j] - p;
+            const float dd = glm::dot(d, d);
+            if (m == kk && !(dd < best[kk - 1].first)) return;
+            for (size_t q = 0; q < m; ++q) {
+              if (best[q].second == j) return;      // bucket visited twice
+            }
+            size_t q = (m < kk) ? m++ : kk - 1;
+            for (; q > 0 && best[q - 1].first > dd; --q) best[q] = best[q - 1];
+            best[q] = { dd, j };
+          };
+          for (int ring = 0; kk; ++ring) {
+            if (size_t(2 * ring + 1) * (2 * ring + 1) * (2 * ring + 1) > n) {
+              // sparse neighborhood, cheaper to check all
+              for (unsigned j = 0; j < n; ++j) consider(j);
+              break;
+            }
+            grid.visit_ring(p, ring, consider);
+            const float reach = ring * cell;      // unvisited points are farther away
+            if (m == kk && best[kk - 1].first <= reach * reach) break;
+          }
+          auto* row = out.data() + i * k;
+          for (size_t q = 0; q < m; ++q) {
+            const auto j = best[q].second;
+            row[q] = { best[q].first, pos[j], j, popj[j].stress, popj[j].get_current_state() };
+          }
+          std::fill(row + m, row + k, neighbor_info{});
+        }
+      });
+    }
+
+
+    template <size_t S1, size_t S2 = 0>
+    void nearest_neighbors_dispatch(const Simulation* sim, size_t s1, size_t s2, const spatial_hash::grid& grid, const std::vector<vec3>& pos, size_t k, std::vector<neighbor_info>& out)
+    {
+      if (s1 == S1 && s2 == S2) nearest_neighbors_of<S1, S2>(sim, grid, pos, k, out);
+      else if constexpr (S2 < n_species - 1) nearest_neighbors_dispatch<S1, S2 + 1>(sim, s1, s2, grid, pos, k, out);
+      else if constexpr (S1 < n_species - 1) nearest_neighbors_dispatch<S1 + 1, 0>(sim, s1, s2, grid, pos, k, out);
+    }
+
+
+    // compact position copy and grid with about 4 agents per cell at the
+    // mean density of the bounding box
+    template <size_t S>
+    void build_knn_index(const Simulation* sim, size_t s, spatial_hash::grid& grid, std::vector<vec3>& pos)
+    {
+      if (s != S) {
+        if constexpr (S < n_species - 1) build_knn_index<S + 1>(sim, s, grid, pos);
+        return;
+      }
+      const auto& pop = sim->pop<std::integral_constant<size_t, S>>();
+      pos.resize(pop.size());
+      auto lo = vec3(std::numeric_limits<float>::max());
+      auto hi = vec3(-std::numeric_limits<float>::max());
+      for (size_t i = 0; i < pop.size(); ++i) {
+        pos[i] = pop[i].pos;
+        lo = glm::min(lo, pos[i]);
+        hi = glm::max(hi, pos[i]);
+      }
+      const auto ext = glm::max(hi - lo, vec3(1.f));
+      const float cell = pos.empty() ? 1.f : std::cbrt(4.f * ext.x * ext.y * ext.z / pos.size());
+      grid.build(pos.size(), cell, [&](size_t i) { return pos[i]; });
+    }
+
+
+    template <size_t S>
+    void save_species(checkpoint::oarchive& ar, const species_pop& pop, const state_array& sa)
+    {
+      const auto& pops = std::get<S>(pop);
+      const auto& ss = std::get<S>(sa);
+      ar.pod(static_cast<uint64_t>(pops.size()));
+      ar.seq(ss.update_times).seq(ss.stress).seq(ss.rng);
+      for (const auto& sni : ss.SNI) ar.seq(sni);     // rows as of their agents' last update
+      ss.ftracker.save(ar);
+      for (const auto& a : pops) a.save(ar);
+      if constexpr (S < n_species - 1) save_species<S + 1>(ar, pop, sa);
+    }
+
+
+    template <size_t S>
+    void load_species(checkpoint::iarchive& ar, species_pop& pop, state_array& sa)
+    {
+      auto& pops = std::get<S>(pop);
+      auto& ss = std::get<S>(sa);
+      uint64_t n = 0;
+      ar.pod(n);
+      if (n != pops.size()) throw std::runtime_error("checkpoint: population size mismatch");
+      ar.seq(ss.update_times).seq(ss.stress).seq(ss.rng);
+      if (ss.update_times.size() != n || ss.rng.size() != n) throw std::runtime_error("checkpoint: corrupted species state");
+      for (size_t k = 0; k < n_species; ++k) {
+        const auto expected = ss.SNI[k].size();
+        ar.seq(ss.SNI[k]);
+        if (ss.SNI[k].size() != expected) throw std::runtime_error("checkpoint: corrupted neighbor info");
+      }
+      ss.ftracker.load(ar);
+      for (auto& a : pops) a.load(ar);
+      if constexpr (S < n_species - 1) load_species<S + 1>(ar, pop, sa);
+    }
+
+
+    // neighbor info of all agents at the current positions
+    template <size_t S>
+    void refresh_neighbor_info(Simulation* sim, species_pop& pop, state_array& sa)
+    {
+      for_each_agent(sim, std::get<S>(pop).size(), [&, sim](auto r) {
+        for (size_t i = r.begin(); i < r.end(); ++i) {
+          update_neighbor_info<S>::apply(sim, i, sa);
+        }
+      });
+      if constexpr (S < n_species - 1) refresh_neighbor_info<S + 1>(sim, pop, sa);
+    }
+
+
+    template <size_t S>
+    void replay_species(Simulation* sim, species_pop& pop, const std::array<std::vector<recorded_state>, n_species>& frame)
+    {
+      auto& pops = std::get<S>(pop);
+      const auto& rs = frame[S];
+      if (!rs.empty()) {
+        if (rs.size() != pops.size()) throw std::runtime_error("replay: population size mismatch");
+        for_each_agent(sim, pops.size(), [&](auto r) {
+          for (size_t i = r.begin(); i < r.end(); ++i) pops[i].replay(rs[i]);
+        });
+      }
+      if constexpr (S < n_species - 1) replay_species<S + 1>(sim, pop, frame);
+    }
+
+
+    template <size_t S>
+    void detect_groups(species_pop& pop, state_array& sa, float fdd)
+    {
+      const auto& pops = std::get<S>(pop);
+      const auto& uts = std::get<S>(sa).update_times;
+      auto& fts = std::get<S>(sa).ftracker;
+      fts.prepare(pops.size());
+      for (size_t i = 0; i < pops.size(); ++i) {
+        if (uts[i] != static_cast<tick_t>(-1)) fts.feed(pops[i], i);
+      }
+      fts.cluster(fdd);
+      if constexpr (S < n_species - 1) detect_groups<S + 1>(pop, sa, fdd);
+    }
+
+
+    // FNV-1a
+    uint64_t hash_combine(uint64_t h, const std::string& str)
+    {
+      for (unsigned char c : str) {
+        h ^= c;
+        h *= 0x100000001b3ull;
+      }
+      return h;
+    }
+
+
+    template <size_t S>
+    uint64_t hash_species_config(const json& J, uint64_t h)
+    {
+      using agent_type = typename std::tuple_element_t<S, species_pop>::value_type;
+      h = hash_combine(h, J[agent_type::name()].dump());
+      if constexpr (S < n_species - 1) return hash_species_config<S + 1>(J, h);
+      return h;
+    }
+
   }
   
 
@@ -245,12 +504,35 @@ namespace model {
   Simulation::Simulation(const json& J) :
     tick_(0)
   {
-    dt_ = J["Simulation"]["dt"];
+    dt_.store(J["Simulation"]["dt"].get<float>());
     float group_threshold = J["Simulation"]["groupDetection"]["threshold"];
     group_dd_ = group_threshold * group_threshold;
     group_update_ = 0;
     group_interval_ = time2tick(J["Simulation"]["groupDetection"]["interval"]);
+    snapshot_interval_ = time2tick(optional_json<double>(J["Simulation"], "snapshot_interval").value_or(0.0));
+    if (auto seed = optional_json<uint64_t>(J["Simulation"], "seed")) {
+      reng = rndutils::make_random_engine<>(*seed);
+    }
+    config_hash_ = hash_combine(0xcbf29ce484222325ull, J["Simulation"]["dt"].dump());
+    config_hash_ = hash_combine(config_hash_, J["Simulation"]["groupDetection"].dump());
+    config_hash_ = hash_species_config<0>(J, config_hash_);
     init_simulation_state(J, species_, state_, *this);
+    if (auto thresholds = optional_json<std::vector<float>>(J["Simulation"]["groupDetection"], "thresholds")) {
+      for (auto& ss : state_) ss.ftracker.hierarchy(*thresholds);
+    }
+  }
+
+
+  Simulation::Simulation(const Simulation& rhs) :
+    tick_(rhs.tick_),
+    group_update_(rhs.group_update_),
+    group_interval_(rhs.group_interval_),
+    group_dd_(rhs.group_dd_),
+    config_hash_(rhs.config_hash_),
+    serial_(rhs.serial_),
+    species_(rhs.species_),
+    state_(rhs.state_)
+  {
   }
 
 
@@ -262,6 +544,7 @@ namespace model {
   void Simulation::initialize(Observer* observer, const species_instances& ss)
   {
     set_instances(ss);
+    if (snapshot_interval_) publish_snapshot();
     notify_observer(observer, Simulation::Initialized, this);
   }
 
@@ -271,6 +554,7 @@ namespace model {
     notify_observer(observer, PreTick, this);
     {
       std::lock_guard<std::recursive_mutex> _(mutex_);
+      refresh_positions<0>(species_, state_);
       update_species<0>(this, species_, state_);
       if (group_update_ == tick_) {
         integrate_species_group<0>(this, species_, state_, group_dd_);
@@ -280,15 +564,102 @@ namespace model {
         integrate_species<0>(this, species_, state_);
       }
       ++tick_;
+      if (snapshot_interval_ && (tick_ % snapshot_interval_) == 0) publish_snapshot();
     }
     notify_observer(observer, Tick, this);
   }
 
 
+  void Simulation::publish_snapshot() const
+  {
+    std::lock_guard<std::recursive_mutex> _(mutex_);
+    auto& snap = snapshots_.back();
+    snap.tick = tick_;
+    fill_snapshot<0>(this, species_, state_, snap);
+    snapshots_.publish();
+  }
+
+
+  void Simulation::nearest_neighbors_impl(size_t S1, size_t S2, size_t k, std::vector<neighbor_info>& out) const
+  {
+    auto _ = read_lock();
+    auto& ki = knn_index_[S2];
+    {
+      std::lock_guard<std::mutex> __(ki.mutex);
+      if (ki.tick != tick_) {
+        build_knn_index<0>(this, S2, ki.grid, ki.pos);
+        ki.tick = tick_;
+      }
+    }
+    nearest_neighbors_dispatch<0>(this, S1, S2, ki.grid, ki.pos, k, out);
+  }
+
+
   void Simulation::set_instances(const species_instances& ss)
   {
     std::lock_guard<std::recursive_mutex> _(mutex_);
     set_instance<0>(this, species_, ss);
+    for (auto& ki : knn_index_) ki.tick = -1;     // moved within the tick
+  }
+
+
+  void Simulation::save(checkpoint::oarchive& ar) const
+  {
+    std::lock_guard<std::recursive_mutex> _(mutex_);
+    ar.pod(tick_).pod(group_update_).pod(reng);
+    save_species<0>(ar, species_, state_);
+  }
+
+
+  void Simulation::load(checkpoint::iarchive& ar)
+  {
+    std::lock_guard<std::recursive_mutex> _(mutex_);
+    ar.pod(tick_).pod(group_update_).pod(reng);
+    load_species<0>(ar, species_, state_);
+    refresh_positions<0>(species_, state_);
+    for (auto& ki : knn_index_) ki.tick = -1;
+  }
+
+
+  void Simulation::replay(tick_t tick, const std::array<std::vector<recorded_state>, n_species>& frame, bool neighbor_info)
+  {
+    std::lock_guard<std::recursive_mutex> _(mutex_);
+    replay_species<0>(this, species_, frame);
+    const auto elapsed = tick - tick_;
+    tick_ = tick;
+    refresh_positions<0>(species_, state_);
+    if (neighbor_info) refresh_neighbor_info<0>(this, species_, state_);
+    if (tick_ > group_update_) {
+      // update() detects on its way from group_update_ to group_update_ + 1
+      detect_groups<0>(species_, state_, group_dd_);
+      const auto interval = std::max(tick_t(1), group_interval_);
+      group_update_ += ((tick_ - 1 - group_update_) / interval + 1) * interval;
+    }
+    else {
+      for (tick_t t = 0; t < elapsed; ++t) {
+        for (auto& ss : state_) ss.ftracker.track();
+      }
+    }
+    for (auto& ki : knn_index_) ki.tick = -1;
+  }
+
+
+  std::unique_ptr<Simulation> Simulation::fork() const
+  {
+    std::lock_guard<std::recursive_mutex> _(mutex_);
+    return std::unique_ptr<Simulation>(new Simulation(*this));
+  }
+
+
+  void Simulation::reseed(uint64_t seed)
+  {
+    std::lock_guard<std::recursive_mutex> _(mutex_);
+    auto master = rndutils::make_random_engine<>(seed);
+    for (auto& s : state_) {
+      for (auto& rng : s.rng) {
+        rng.seed(master());
+      }
+    }
   }
 
 
@@ -2,10 +2,15 @@
 #define MODEL_SIMULATION_HPP_INCLUDED
 
 #include <mutex>
+#include <utility>
 #include <atomic>
 #include <bitset>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
 #include <model/json.hpp>
+#include <libs/spatial_hash.hpp>
 #include <model/group.hpp>
+#include <model/snapshot.hpp>
 
 
 namespace model {
@@ -13,7 +18,7 @@ namespace model {
   class Simulation
   {
   private:
-    static float dt_;
+    static std::atomic<float> dt_;   // shared by all instances in the process
 
   public:
     enum Msg {
@@ -32,18 +37,41 @@ namespace model {
     void set_instances(const species_instances& ss);
     species_instances get_instances() const;
 
+    // checkpoint support, see checkpoint.hpp
+    void save(checkpoint::oarchive& ar) const;
+    void load(checkpoint::iarchive& ar);
+    uint64_t config_hash() const noexcept { return config_hash_; }
+
+    // replay support, see analysis/replay.hpp
+    // Moves the agents to their recorded states at 'tick', species with an empty
+    // frame stay put. Groups are detected or tracked as by update(); the sorted
+    // neighbor info behind sorted_view() is recomputed only on request (costly).
+    void replay(tick_t tick, const std::array<std::vector<recorded_state>, n_species>& frame, bool neighbor_info);
+    tick_t next_group_detection() const noexcept { return group_update_; }   // visible from the next tick on
+
+    // deep copy of the current state, internally synchronized.
+    // The copy starts without observers, forced updates or termination request.
+    std::unique_ptr<Simulation> fork() const;
+
+    // reseeds the per-agent random streams, e.g. of a fork
+    void reseed(uint64_t seed);
+
     // request forced neighbor info update every tick
     void force_neighbor_info_update(bool required) const { force_ni_update_.fetch_add(required ? +1 : -1); }
     bool forced_neighbor_info_update() const { return force_ni_update_.load(std::memory_order_acquire) > 0; }
 
+    // run updates in the calling thread, for replicate-level parallelism of small simulations
+    void serial(bool val) noexcept { serial_ = val; }
+    bool serial() const noexcept { return serial_; }
+
     void update(class Observer* observer);
     
-    static float dt() noexcept { return dt_; }      // [s]
+    static float dt() noexcept { return dt_.load(std::memory_order_relaxed); }      // [s]
 
     tick_t tick() const noexcept { return tick_; }  // [1]
-    static tick_t time2tick(double time) noexcept { return static_cast<tick_t>(time / dt_); }  // [1]
-    double time() const noexcept { return static_cast<double>(dt_) * tick_; }                 // [s]
-    static double tick2time(tick_t tick) noexcept { return static_cast<double>(dt_) * tick; } // [s]
+    static tick_t time2tick(double time) noexcept { return static_cast<tick_t>(time / dt()); }  // [1]
+    double time() const noexcept { return static_cast<double>(dt()) * tick_; }                 // [s]
+    static double tick2time(tick_t tick) noexcept { return static_cast<double>(dt()) * tick; } // [s]
 
     // returns const reference to population vector that
     template <typename Tag>
@@ -66,6 +94,19 @@ namespace model {
       return raw_view_impl<Tag::value, OtherTag::value>(idx);
     }
 
+    // Exactly the k nearest individuals of OtherTag for all individuals of Tag
+    // ('self' excluded), row-major n x k by ascending distance, padded with
+    // neighbor_info{}. Computed on demand from the current positions through a
+    // spatial index built once per tick; leaves the agents' neighbor info alone.
+    // Internally synchronized.
+    template <typename Tag, typename OtherTag = Tag>
+    void nearest_neighbors(size_t k, std::vector<neighbor_info>& out) const
+    {
+      nearest_neighbors_impl(Tag::value, OtherTag::value, k, out);
+    }
+
+    float group_threshold() const noexcept { return std::sqrt(group_dd_); }   // [m]
+
     template <typename Tag>
     const std::vector<group_descr>& groups() const noexcept
     {
@@ -84,28 +125,85 @@ namespace model {
       return std::get<Tag::value>(state_).ftracker.id_of(idx);
     }
 
+    // members of group_id in ascending order
+    template <typename Tag>
+    std::span<const unsigned> group_members(size_t group_id) const noexcept
+    {
+      return std::get<Tag::value>(state_).ftracker.members(static_cast<int>(group_id));
+    }
+
+    // cached per-group statistics
+    template <typename Tag>
+    const std::vector<group_aggregates>& group_stats() const noexcept
+    {
+      return std::get<Tag::value>(state_).ftracker.aggregates();
+    }
+
+    // groups at the additional thresholds of groupDetection
+    template <typename Tag>
+    const std::vector<group_level>& group_levels() const noexcept
+    {
+      return std::get<Tag::value>(state_).ftracker.levels();
+    }
+
+    // splits and merges found by the last group detection
+    template <typename Tag>
+    const std::vector<group_event>& group_events() const noexcept
+    {
+      return std::get<Tag::value>(state_).ftracker.events();
+    }
+
     template <typename Tag>
     std::vector<int> group_mates(size_t group_id) const
     {
-      auto fm = std::vector<int>{};
-      for (size_t i = 0; i < state_[Tag::value].ftracker.pop_size(); ++i) {
-        if (group_of<Tag>(i) == group_id) {
-          fm.push_back(static_cast<int>(i));
-        }
-      }
-      return fm;
+      const auto gm = group_members<Tag>(group_id);
+      return std::vector<int>(gm.begin(), gm.end());
     }
 
     // Access from foreign threads
+
+    // publishes a state_snapshot at the end of every 'interval'-th tick, 0: off
+    void snapshot_interval(tick_t interval) noexcept { snapshot_interval_ = interval; }
+    tick_t snapshot_interval() const noexcept { return snapshot_interval_; }
+
+    // takes and publishes a snapshot now, internally synchronized
+    void publish_snapshot() const;
+
+    // Latest published snapshot, never blocks the simulation.
+    // Single consumer (e.g. the GUI thread); the reference stays valid
+    // until the next call.
+    const state_snapshot& acquire_snapshot() const noexcept
+    {
+      snapshots_.acquire();
+      return snapshots_.front();
+    }
     
     void terminate() const noexcept { terminate_.store(true, std::memory_order_release); }
     bool terminated() const noexcept { return terminate_.load(std::memory_order_acquire); }
 
+    // Calls fun(i) for i in [0, n) concurrently while the calling thread holds
+    // the simulation lock. The internally synchronized visits from these tasks
+    // share that lock; fun must not modify the simulation.
+    template <typename Fun>
+    void shared_read(size_t n, Fun&& fun) const
+    {
+      std::lock_guard<std::recursive_mutex> _(mutex_);
+      if (serial_ || n < 2) {
+        for (size_t i = 0; i < n; ++i) fun(i);
+        return;
+      }
+      tbb::parallel_for(size_t(0), n, [&](size_t i) {
+        const auto* outer = std::exchange(shared_reader_, this);
+        tbb::this_task_arena::isolate([&] { fun(i); });
+        shared_reader_ = outer;
+      });
+    }
+
     // calls fun for all individuals, internally synchronized
     template <typename Tag, typename Fun>
     size_t visit_all(Fun&& fun) const
     {
-      std::lock_guard<std::recursive_mutex> _(mutex_);
+      auto _ = read_lock();
       auto& pop = std::get<Tag::value>(species_);
       size_t n = 0;
       for (size_t i = 0; i < pop.size(); ++i) {
@@ -114,11 +212,28 @@ namespace model {
       return n;
     }
 
+    // calls fun(agent, idx) for all individuals in parallel, internally synchronized.
+    // Runs inline for serial simulations.
+    template <typename Tag, typename Fun>
+    size_t parallel_visit_all(Fun&& fun) const
+    {
+      auto _ = read_lock();
+      auto& pop = std::get<Tag::value>(species_);
+      auto body = [&](const tbb::blocked_range<size_t>& r) {
+        for (size_t i = r.begin(); i < r.end(); ++i) {
+          fun(pop[i], i);
+        }
+      };
+      if (serial_) body(tbb::blocked_range<size_t>(0, pop.size()));
+      else tbb::parallel_for(tbb::blocked_range<size_t>(0, pop.size()), body);
+      return pop.size();
+    }
+
     // calls fun for all individuals, internally synchronized
     template <typename Tag, typename Fun>
     size_t visit(Fun&& fun) const
     {
-      std::lock_guard<std::recursive_mutex> _(mutex_);
+      auto _ = read_lock();
       auto& pop = std::get<Tag::value>(species_);
       size_t n = 0;
       for (size_t i = 0; i < pop.size(); ++i) {
@@ -133,7 +248,7 @@ namespace model {
     template <typename Tag, typename Fun>
     size_t visit(size_t idx, Fun&& fun) const
     {
-      std::lock_guard<std::recursive_mutex> _(mutex_);
+      auto _ = read_lock();
       auto& pop = std::get<Tag::value>(species_);
       assert(idx < pop.size());
       size_t n = 0;
@@ -142,6 +257,17 @@ namespace model {
     }
 
   private:
+    Simulation(const Simulation& rhs);     // see fork()
+
+    void nearest_neighbors_impl(size_t S1, size_t S2, size_t k, std::vector<neighbor_info>& out) const;
+
+    // simulation lock, unless held for this thread by shared_read()
+    std::unique_lock<std::recursive_mutex> read_lock() const
+    {
+      if (shared_reader_ == this) return {};
+      return std::unique_lock<std::recursive_mutex>(mutex_);
+    }
+
     // returns exclusive neighborhood sorted by distance
     template <size_t S1, size_t S2>
     neighbor_info_view sorted_view_impl(size_t idx) const noexcept
@@ -170,18 +296,35 @@ namespace model {
     tick_t group_update_ = 0;
     tick_t group_interval_ = 0;
     float group_dd_ = 0.f;
+    uint64_t config_hash_ = 0;
+    bool serial_ = false;
+    tick_t snapshot_interval_ = 0;
 
 
     mutable std::atomic<int> force_ni_update_ = 0;       // forced neighbor info update every tick if > 0
     mutable std::recursive_mutex mutex_;                 // simulation lock
     mutable species_pop species_;
     mutable std::atomic<bool> terminate_ = false;
+    mutable triple_buffer<state_snapshot> snapshots_;
+    static inline thread_local const Simulation* shared_reader_ = nullptr;
+
+    // spatial index for nearest_neighbors(), not copied by fork()
+    struct knn_index_t
+    {
+      std::mutex mutex;
+      tick_t tick = -1;
+      spatial_hash::grid grid;
+      std::vector<vec3> pos;
+    };
+    mutable std::array<knn_index_t, n_species> knn_index_;
 
     struct state_t
     {
       size_t size()const noexcept { return update_times.size(); }
       std::vector<tick_t> update_times;
       std::vector<float> stress;
+      std::vector<rndutils::default_engine> rng;                // per-agent random streams
+      std::array<std::vector<float>, 3> spos;                   // positions, structure of arrays
       std::array<std::vector<neighbor_info>, n_species> SNI;   // sorted neighbor info matrices
       group_tracker ftracker;
     };
@@ -0,0 +1,71 @@
+#ifndef MODEL_SNAPSHOT_HPP_INCLUDED
+#define MODEL_SNAPSHOT_HPP_INCLUDED
+
+#include <array>
+#include <vector>
+#include <atomic>
+#include <model/model.hpp>
+
+
+namespace model {
+
+  // read-only copy of one species
+  struct species_snapshot
+  {
+    size_t size() const noexcept { return instances.size(); }
+
+    std::vector<instance_proxy> instances;    // body frame (pos, dir, banking), speed, color, state
+    std::vector<glm::vec3> pos;
+    std::vector<glm::vec3> dir;
+    std::vector<float> stress;
+    std::vector<int> group;                   // group id, -1: not yet detected
+    std::vector<float> nnd;                   // distance to the nearest conspecific, 0: none
+  };
+
+
+  // read-only copy of the simulation state, see Simulation::snapshot_interval()
+  struct state_snapshot
+  {
+    tick_t tick = 0;
+    std::array<species_snapshot, n_species> species;
+  };
+
+
+  // Lock-free single producer, single consumer triple buffer.
+  // The producer fills back() and publishes it, the consumer switches
+  // to the latest published buffer; neither waits for the other.
+  template <typename T>
+  class triple_buffer
+  {
+  public:
+    // producer
+    T& back() noexcept { return buf_[back_]; }
+
+    void publish() noexcept
+    {
+      back_ = middle_.exchange(back_ | fresh, std::memory_order_acq_rel) & index_mask;
+    }
+
+    // consumer, returns true if front() changed
+    bool acquire() noexcept
+    {
+      if (!(middle_.load(std::memory_order_relaxed) & fresh)) return false;
+      front_ = middle_.exchange(front_, std::memory_order_acq_rel) & index_mask;
+      return true;
+    }
+
+    const T& front() const noexcept { return buf_[front_]; }
+
+  private:
+    static constexpr unsigned fresh = 4;
+    static constexpr unsigned index_mask = 3;
+
+    std::array<T, 3> buf_;
+    unsigned back_ = 0;
+    std::atomic<unsigned> middle_ = 1;
+    unsigned front_ = 2;
+  };
+
+}
+
+#endif
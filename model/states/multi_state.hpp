@@ -66,6 +66,19 @@ namespace model {
         sub_states_[current_sub_state_]->resume(self, idx, T, sim);
       }
 
+      void save(checkpoint::oarchive& ar) const override {
+        ar.pod(current_sub_state_);
+        if constexpr (requires { selector_.save(ar); }) selector_.save(ar);
+        for (const auto& ss : sub_states_) ss->save(ar);
+      }
+
+      void load(checkpoint::iarchive& ar) override {
+        ar.pod(current_sub_state_);
+        if constexpr (requires { selector_.load(ar); }) selector_.load(ar);
+        for (auto& ss : sub_states_) ss->load(ar);
+      }
+
+      std::unique_ptr<base_type> clone() const override { return std::make_unique<multi_state>(*this); }
       bool is_copyable() const noexcept override { return copyable_; }
       size_t sub_states() const override { return num_substates(); }
       static constexpr size_t num_substates() noexcept { return sizeof...(SubStates); }
@@ -81,7 +94,7 @@ namespace model {
 
     private:
       friend Selector;
-      std::array<std::unique_ptr<state<Agent>>, sizeof...(SubStates)> sub_states_;
+      std::array<clone_ptr<state<Agent>>, sizeof...(SubStates)> sub_states_;
       size_t current_sub_state_ = 0;
       bool copyable_ = false;
       Selector selector_;
@@ -55,6 +55,18 @@ namespace model {
         }
       };
 
+      void save(checkpoint::oarchive& ar) const override
+      {
+        ar.pod(t_exit_).pod(effective_dur_).seq(actions_potential_);
+        save_actions<0>(ar);
+      }
+
+      void load(checkpoint::iarchive& ar) override
+      {
+        ar.pod(t_exit_).pod(effective_dur_).seq(actions_potential_);
+        load_actions<0>(ar);
+      }
+
     public:
       tick_t t_exit_;
     protected:
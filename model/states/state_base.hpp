@@ -2,6 +2,7 @@
 #define MODEL_STATES_BASE_HPP_INCLUDED
 
 #include <model/simulation.hpp>
+#include <model/checkpoint.hpp>
 #include <model/flight.hpp>
 
 
@@ -27,6 +28,37 @@ namespace model {
     inline constexpr size_t package_idx() { return tuple_idx<0, typename Package::package_tuple, Elem>(); }
 
 
+    // unique ownership with deep copy (T::clone) semantics
+    template <typename T>
+    class clone_ptr
+    {
+    public:
+      clone_ptr() = default;
+      clone_ptr(clone_ptr&&) noexcept = default;
+      clone_ptr& operator=(clone_ptr&&) noexcept = default;
+
+      template <typename U>
+      clone_ptr(std::unique_ptr<U>&& p) noexcept : p_(std::move(p)) {}
+
+      clone_ptr(const clone_ptr& rhs) : p_(rhs.p_ ? rhs.p_->clone() : nullptr) {}
+
+      clone_ptr& operator=(const clone_ptr& rhs)
+      {
+        if (this != &rhs) p_ = rhs.p_ ? rhs.p_->clone() : nullptr;
+        return *this;
+      }
+
+      void reset(T* p = nullptr) noexcept { p_.reset(p); }
+      T* get() const noexcept { return p_.get(); }
+      T* operator->() const noexcept { return p_.get(); }
+      T& operator*() const noexcept { return *p_; }
+      explicit operator bool() const noexcept { return static_cast<bool>(p_); }
+
+    private:
+      std::unique_ptr<T> p_;
+    };
+
+
     // abstract state
     template <typename Agent>
     class state
@@ -42,6 +74,11 @@ namespace model {
       virtual bool is_copyable() const noexcept = 0;
       virtual std::string descr() const = 0;
       virtual size_t sub_states() const { return 0; }
+      virtual std::unique_ptr<state> clone() const = 0;
+
+      // runtime state for checkpoints
+      virtual void save(checkpoint::oarchive& ar) const = 0;
+      virtual void load(checkpoint::iarchive& ar) = 0;
     };
 
 
@@ -55,7 +92,7 @@ namespace model {
       using package_tuple = std::tuple<States...>;
       using base_type = typename std::tuple_element_t<0, package_tuple>::base_type;
       using agent_type = typename base_type::agent_type;
-      using package_array = std::array<std::unique_ptr<base_type>, size>;
+      using package_array = std::array<clone_ptr<base_type>, size>;
       using transition_matrix = std::array<std::array<float, size>, size>;
 
       static package_array create(size_t idx, const json& J)
@@ -95,6 +132,7 @@ public: \
   using base_type = state<agent_type>; \
   static constexpr const char* name() noexcept { return #a; } \
   std::string descr() const override { return descr_; } \
+  std::unique_ptr<base_type> clone() const override { return std::make_unique<a>(*this); } \
 protected: \
   using action_pack = IP; \
   using action_tuple = typename action_pack::package_tuple; \
@@ -121,6 +159,16 @@ protected: \
     actions_potential_.push_back(std::get<I>(actions).assess_entry(self, idx, T, sim)); \
     if constexpr (I < action_pack::size - 1) chain_assess_entry<I + 1>(self, idx, T, sim); \
   } \
+  template <size_t I> \
+  void save_actions(checkpoint::oarchive& ar) const { \
+    ar.pod(std::get<I>(actions)); \
+    if constexpr (I < action_pack::size - 1) save_actions<I + 1>(ar); \
+  } \
+  template <size_t I> \
+  void load_actions(checkpoint::iarchive& ar) { \
+    ar.pod(std::get<I>(actions)); \
+    if constexpr (I < action_pack::size - 1) load_actions<I + 1>(ar); \
+  } \
 private: \
   bool is_copyable() const noexcept override { return copyable_; } \
   std::string descr_; \
@@ -47,6 +47,18 @@ namespace model {
         self->on_state_exit(idx, T, sim);
       };
 
+      void save(checkpoint::oarchive& ar) const override
+      {
+        ar.seq(actions_potential_);
+        save_actions<0>(ar);
+      }
+
+      void load(checkpoint::iarchive& ar) override
+      {
+        ar.seq(actions_potential_);
+        load_actions<0>(ar);
+      }
+
     protected: 
       tick_t tr_;  // [tick]
 	    flight::state_aero<float> sai_; // state specific aero info